@@ -0,0 +1,82 @@
+# Turns a text map into a header with the tiles as constexpr data, run in script mode:
+#   cmake -DTERRAIN_TEXT=<terrain.txt> -DTERRAIN_TEMPLATE=<baked_terrain.h.in> -DTERRAIN_HEADER=<baked_terrain.h> -P bake_terrain.cmake
+# Reads the map the same way as Terrain::parse_text_map: the row count on the first line, empty rows are grass rows,
+# the widest row sets the width and short rows are filled up with grass
+cmake_minimum_required(VERSION 3.4)
+cmake_policy(SET CMP0007 NEW) # keep empty rows in the list of rows
+
+file(READ ${TERRAIN_TEXT} TERRAIN_TEXT_CONTENT)
+
+string(FIND "${TERRAIN_TEXT_CONTENT}" "\n" HEADER_END)
+if(HEADER_END LESS 0)
+    message(FATAL_ERROR "${TERRAIN_TEXT} has no row count line")
+endif()
+
+# Row count like atoi: leading blanks and an optional sign, anything else counts as 0 rows
+string(SUBSTRING "${TERRAIN_TEXT_CONTENT}" 0 ${HEADER_END} HEADER_LINE)
+set(TERRAIN_HEIGHT 0)
+if(HEADER_LINE MATCHES "^[ \t\r]*([+-]?[0-9]+)")
+    set(TERRAIN_HEIGHT ${CMAKE_MATCH_1})
+    if(TERRAIN_HEIGHT LESS 0)
+        set(TERRAIN_HEIGHT 0)
+    endif()
+endif()
+
+# Rows without a line ending carriage return, every character other than F, R, M and W is grass
+# Mapping the rest to G up front also keeps list separators and brackets out of the rows
+math(EXPR ROWS_START "${HEADER_END} + 1")
+string(SUBSTRING "${TERRAIN_TEXT_CONTENT}" ${ROWS_START} -1 TERRAIN_ROWS)
+string(REPLACE "\r\n" "\n" TERRAIN_ROWS "${TERRAIN_ROWS}")
+string(TOUPPER "${TERRAIN_ROWS}" TERRAIN_ROWS)
+string(REGEX REPLACE "[^FRMW\n]" "G" TERRAIN_ROWS "${TERRAIN_ROWS}")
+string(REPLACE "\n" ";" TERRAIN_LINES "${TERRAIN_ROWS}")
+list(LENGTH TERRAIN_LINES LINE_COUNT)
+
+set(TERRAIN_WIDTH 0)
+foreach(INDEX RANGE ${TERRAIN_HEIGHT})
+    if(INDEX LESS TERRAIN_HEIGHT AND INDEX LESS LINE_COUNT)
+        list(GET TERRAIN_LINES ${INDEX} LINE)
+        string(LENGTH "${LINE}" LENGTH)
+        if(LENGTH GREATER TERRAIN_WIDTH)
+            set(TERRAIN_WIDTH ${LENGTH})
+        endif()
+    endif()
+endforeach()
+
+if(TERRAIN_WIDTH EQUAL 0 OR TERRAIN_HEIGHT EQUAL 0)
+    message(FATAL_ERROR "${TERRAIN_TEXT} has no tiles to bake")
+endif()
+
+# Tile bytes of the binary map format: TileType in the low bits, 8 (Terrain::tile_passable) on tiles that can be crossed
+set(TERRAIN_TILES "")
+foreach(ROW RANGE 1 ${TERRAIN_HEIGHT})
+    math(EXPR INDEX "${ROW} - 1")
+    set(LINE "")
+    if(INDEX LESS LINE_COUNT)
+        list(GET TERRAIN_LINES ${INDEX} LINE)
+    endif()
+    string(LENGTH "${LINE}" LENGTH)
+
+    set(ROW_TILES "   ")
+    foreach(COLUMN RANGE 1 ${TERRAIN_WIDTH})
+        math(EXPR CHAR_INDEX "${COLUMN} - 1")
+        set(TILE 8)
+        if(CHAR_INDEX LESS LENGTH)
+            string(SUBSTRING "${LINE}" ${CHAR_INDEX} 1 CHAR)
+            if(CHAR STREQUAL "F")
+                set(TILE 9)
+            elseif(CHAR STREQUAL "R")
+                set(TILE 10)
+            elseif(CHAR STREQUAL "M")
+                set(TILE 3)
+            elseif(CHAR STREQUAL "W")
+                set(TILE 4)
+            endif()
+        endif()
+        set(ROW_TILES "${ROW_TILES} ${TILE},")
+    endforeach()
+    set(TERRAIN_TILES "${TERRAIN_TILES}${ROW_TILES}\n")
+endforeach()
+
+get_filename_component(TERRAIN_SOURCE ${TERRAIN_TEXT} NAME)
+configure_file(${TERRAIN_TEMPLATE} ${TERRAIN_HEADER} @ONLY)
@@ -0,0 +1,326 @@
+#include "precomp.h"
+#include "cluster_graph.h"
+
+namespace Tmpl8
+{
+void ClusterGraph::build(int width, int height, const std::vector<float>& costs)
+{
+    this->width = width;
+    this->height = height;
+    this->costs = &costs;
+
+    clusters_x = (width + cluster_size - 1) / cluster_size;
+    const int clusters_y = (height + cluster_size - 1) / cluster_size;
+
+    node_tiles.clear();
+    edges.clear();
+    node_of_tile.assign((size_t)width * height, -1);
+    cluster_nodes.assign((size_t)clusters_x * clusters_y, {});
+
+    uniform_clusters.resize(cluster_nodes.size());
+    for (int cluster = 0; cluster < (int)cluster_nodes.size(); cluster++)
+    {
+        const ClusterRect rect = cluster_rect((cluster / clusters_x) * cluster_size * width + (cluster % clusters_x) * cluster_size);
+        uniform_clusters[cluster] = has_uniform_cost(costs, width, GridRegion{ rect.x, rect.y, rect.width, rect.height });
+    }
+
+    auto open = [&costs](int tile_a, int tile_b) { return std::isfinite(costs[tile_a]) && std::isfinite(costs[tile_b]); };
+
+    //Entrances on the border between a cluster and the one to its right, one per run of open tile pairs
+    for (int cy = 0; cy < clusters_y; cy++)
+    {
+        for (int cx = 0; cx + 1 < clusters_x; cx++)
+        {
+            const int x = (cx + 1) * cluster_size - 1;
+            const int y_end = std::min((cy + 1) * cluster_size, height);
+
+            int run_start = -1;
+            for (int y = cy * cluster_size; y <= y_end; y++)
+            {
+                const bool is_open = y < y_end && open(y * width + x, y * width + x + 1);
+                if (is_open && run_start < 0) run_start = y;
+                if (!is_open && run_start >= 0)
+                {
+                    add_entrances(run_start * width + x, run_start * width + x + 1, width, y - run_start);
+                    run_start = -1;
+                }
+            }
+        }
+    }
+
+    //Entrances on the border between a cluster and the one below it
+    for (int cy = 0; cy + 1 < clusters_y; cy++)
+    {
+        for (int cx = 0; cx < clusters_x; cx++)
+        {
+            const int y = (cy + 1) * cluster_size - 1;
+            const int x_end = std::min((cx + 1) * cluster_size, width);
+
+            int run_start = -1;
+            for (int x = cx * cluster_size; x <= x_end; x++)
+            {
+                const bool is_open = x < x_end && open(y * width + x, (y + 1) * width + x);
+                if (is_open && run_start < 0) run_start = x;
+                if (!is_open && run_start >= 0)
+                {
+                    add_entrances(y * width + run_start, (y + 1) * width + run_start, 1, x - run_start);
+                    run_start = -1;
+                }
+            }
+        }
+    }
+
+    //Connect the entrances of each cluster with the cost of the fastest route inside the cluster
+    std::vector<float> cluster_costs;
+    for (const std::vector<int>& nodes : cluster_nodes)
+    {
+        for (int from : nodes)
+        {
+            search_cluster(node_tiles[from], false, cluster_costs, nullptr);
+            const ClusterRect rect = cluster_rect(node_tiles[from]);
+
+            for (int to : nodes)
+            {
+                const float cost = cluster_costs[rect.local(node_tiles[to] % width, node_tiles[to] / width)];
+                if (to != from && std::isfinite(cost)) edges[from].push_back({ to, cost });
+            }
+        }
+    }
+}
+
+std::vector<int> ClusterGraph::find_abstract_path(int start, int goal) const
+{
+    if (!std::isfinite((*costs)[goal])) return {};
+    if (start == goal) return { start };
+
+    //Start and goal are temporary nodes, connected to the entrances of their clusters
+    const int start_node = node_count();
+    const int goal_node = start_node + 1;
+
+    static thread_local std::vector<float> start_costs;
+    static thread_local std::vector<float> goal_costs;
+    search_cluster(start, false, start_costs, nullptr);
+    search_cluster(goal, true, goal_costs, nullptr);
+
+    const ClusterRect start_rect = cluster_rect(start);
+    const ClusterRect goal_rect = cluster_rect(goal);
+    const bool same_cluster = start_rect.x == goal_rect.x && start_rect.y == goal_rect.y;
+    const int start_cluster = cluster_index(start);
+    const int goal_cluster = cluster_index(goal);
+
+    auto node_tile = [this, start_node, start, goal](int node) { return (node < start_node) ? node_tiles[node] : ((node == start_node) ? start : goal); };
+    auto heuristic = [this, goal](int tile) { return (float)(std::abs(tile % width - goal % width) + std::abs(tile / width - goal / width)); };
+
+    //A* over the abstract graph, every tile costs at least 1 so the Manhattan distance never overestimates
+    static thread_local PathScratch scratch;
+    scratch.begin((size_t)node_count() + 2);
+    const uint32_t search_epoch = scratch.epoch;
+
+    auto relax = [&](int current, int next, float edge_cost) {
+        if (scratch.closed_stamp[next] == search_epoch) return;
+
+        const float cost = scratch.path_cost[current] + edge_cost;
+        if (scratch.seen_stamp[next] != search_epoch || cost < scratch.path_cost[next])
+        {
+            scratch.seen_stamp[next] = search_epoch;
+            scratch.path_cost[next] = cost;
+            scratch.parent[next] = current;
+
+            scratch.open_heap.emplace_back(cost + heuristic(node_tile(next)), next);
+            std::push_heap(scratch.open_heap.begin(), scratch.open_heap.end(), PathScratch::heap_order);
+        }
+    };
+
+    scratch.path_cost[start_node] = 0.f;
+    scratch.parent[start_node] = -1;
+    scratch.seen_stamp[start_node] = search_epoch;
+    scratch.open_heap.emplace_back(heuristic(start), start_node);
+
+    bool route_found = false;
+    while (!scratch.open_heap.empty())
+    {
+        std::pop_heap(scratch.open_heap.begin(), scratch.open_heap.end(), PathScratch::heap_order);
+        const int current = scratch.open_heap.back().second;
+        scratch.open_heap.pop_back();
+
+        if (scratch.closed_stamp[current] == search_epoch) continue;
+        scratch.closed_stamp[current] = search_epoch;
+
+        if (current == goal_node)
+        {
+            route_found = true;
+            break;
+        }
+
+        if (current == start_node)
+        {
+            for (int next : cluster_nodes[start_cluster])
+            {
+                const float cost = start_costs[start_rect.local(node_tiles[next] % width, node_tiles[next] / width)];
+                if (std::isfinite(cost)) relax(current, next, cost);
+            }
+
+            const float direct_cost = same_cluster ? start_costs[start_rect.local(goal % width, goal / width)] : numeric_limits<float>::infinity();
+            if (std::isfinite(direct_cost)) relax(current, goal_node, direct_cost);
+            continue;
+        }
+
+        for (const Edge& edge : edges[current])
+        {
+            relax(current, edge.to, edge.cost);
+        }
+
+        const int tile = node_tiles[current];
+        if (cluster_index(tile) == goal_cluster)
+        {
+            const float cost = goal_costs[goal_rect.local(tile % width, tile / width)];
+            if (std::isfinite(cost)) relax(current, goal_node, cost);
+        }
+    }
+
+    if (!route_found) return {};
+
+    std::vector<int> path;
+    for (int node = goal_node; node >= 0; node = scratch.parent[node])
+    {
+        path.push_back(node_tile(node));
+    }
+    std::reverse(path.begin(), path.end());
+
+    return path;
+}
+
+void ClusterGraph::refine(int from, int to, std::vector<int>& tiles) const
+{
+    //Nothing to refine on a graph that was never built
+    if (costs == nullptr) return;
+
+    //Across a cluster border the tiles are neighbours
+    if (std::abs(from % width - to % width) + std::abs(from / width - to / width) == 1)
+    {
+        tiles.push_back(to);
+        return;
+    }
+
+    //Clusters where every open tile costs the same only expand the jump points
+    const ClusterRect rect = cluster_rect(from);
+    if (uniform_clusters[cluster_index(from)])
+    {
+        const std::vector<int> route = jump_point_search(*costs, width, GridRegion{ rect.x, rect.y, rect.width, rect.height }, from, to);
+        tiles.insert(tiles.end(), route.begin() + std::min<size_t>(1, route.size()), route.end());
+        return;
+    }
+
+    static thread_local std::vector<float> cluster_costs;
+    static thread_local std::vector<int> parents;
+    search_cluster(from, false, cluster_costs, &parents);
+
+    //Walk the parents back from the end of the segment
+    const size_t first = tiles.size();
+    for (int local = rect.local(to % width, to / width); local >= 0 && local != rect.local(from % width, from / width); local = parents[local])
+    {
+        tiles.push_back((rect.y + local / rect.width) * width + rect.x + local % rect.width);
+    }
+    std::reverse(tiles.begin() + first, tiles.end());
+}
+
+ClusterGraph::ClusterRect ClusterGraph::cluster_rect(int tile) const
+{
+    const int x = (tile % width) / cluster_size * cluster_size;
+    const int y = (tile / width) / cluster_size * cluster_size;
+    return { x, y, std::min(cluster_size, width - x), std::min(cluster_size, height - y) };
+}
+
+int ClusterGraph::cluster_index(int tile) const
+{
+    return (tile / width) / cluster_size * clusters_x + (tile % width) / cluster_size;
+}
+
+int ClusterGraph::add_node(int tile)
+{
+    if (node_of_tile[tile] >= 0) return node_of_tile[tile];
+
+    const int node = (int)node_tiles.size();
+    node_of_tile[tile] = node;
+    node_tiles.push_back(tile);
+    edges.emplace_back();
+    cluster_nodes[cluster_index(tile)].push_back(node);
+
+    return node;
+}
+
+void ClusterGraph::add_entrances(int tile_a, int tile_b, int step, int length)
+{
+    auto connect = [this](int a, int b) {
+        const int node_a = add_node(a);
+        const int node_b = add_node(b);
+        edges[node_a].push_back({ node_b, (*costs)[b] });
+        edges[node_b].push_back({ node_a, (*costs)[a] });
+    };
+
+    //Long openings get an entrance at both ends, short ones a single entrance in the middle
+    if (length >= 6)
+    {
+        connect(tile_a, tile_b);
+        connect(tile_a + (length - 1) * step, tile_b + (length - 1) * step);
+    }
+    else
+    {
+        connect(tile_a + (length / 2) * step, tile_b + (length / 2) * step);
+    }
+}
+
+void ClusterGraph::search_cluster(int tile, bool backward, std::vector<float>& cluster_costs, std::vector<int>* parents) const
+{
+    const ClusterRect rect = cluster_rect(tile);
+    const int tile_count = rect.width * rect.height;
+
+    cluster_costs.assign(tile_count, numeric_limits<float>::infinity());
+    if (parents != nullptr) parents->assign(tile_count, -1);
+
+    std::vector<std::pair<float, int>> open_heap;
+    std::vector<bool> closed(tile_count, false);
+
+    const int source = rect.local(tile % width, tile / width);
+    cluster_costs[source] = 0.f;
+    open_heap.emplace_back(0.f, source);
+
+    while (!open_heap.empty())
+    {
+        std::pop_heap(open_heap.begin(), open_heap.end(), PathScratch::heap_order);
+        const int current = open_heap.back().second;
+        open_heap.pop_back();
+
+        if (closed[current]) continue;
+        closed[current] = true;
+
+        //Only the source may be a tile that can not be crossed, routes can start on it but never go through it
+        const int x = rect.x + current % rect.width;
+        const int y = rect.y + current / rect.width;
+        const float current_tile_cost = (*costs)[y * width + x];
+        if (current != source && !std::isfinite(current_tile_cost)) continue;
+
+        const int neighbours[4][2] = { { x + 1, y }, { x - 1, y }, { x, y + 1 }, { x, y - 1 } };
+        for (const auto& neighbour : neighbours)
+        {
+            if (neighbour[0] < rect.x || neighbour[0] >= rect.x + rect.width || neighbour[1] < rect.y || neighbour[1] >= rect.y + rect.height) continue;
+
+            const int next = rect.local(neighbour[0], neighbour[1]);
+            if (closed[next]) continue;
+
+            //Forward the neighbour is entered, backward the neighbour drives onto the current tile
+            const float step_cost = backward ? current_tile_cost : (*costs)[neighbour[1] * width + neighbour[0]];
+            const float cost = cluster_costs[current] + step_cost;
+            if (cost < cluster_costs[next])
+            {
+                cluster_costs[next] = cost;
+                if (parents != nullptr) (*parents)[next] = current;
+
+                open_heap.emplace_back(cost, next);
+                std::push_heap(open_heap.begin(), open_heap.end(), PathScratch::heap_order);
+            }
+        }
+    }
+}
+
+} // namespace Tmpl8
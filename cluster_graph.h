@@ -0,0 +1,86 @@
+#pragma once
+
+namespace Tmpl8
+{
+//Route for hierarchical path finding, only the segment that is being driven is refined into tiles
+//A complete tile route is a single segment that is already refined, it is followed without the cluster graph
+struct HierarchicalRoute
+{
+    static HierarchicalRoute from_tiles(std::vector<int> tiles)
+    {
+        HierarchicalRoute route;
+        route.abstract_path = { tiles.front(), tiles.back() };
+        route.abstract_index = 1;
+        route.segment = std::move(tiles);
+        route.segment_index = 1;
+        return route;
+    }
+
+    //Tiles of the abstract route, from the start tile over cluster entrances to the destination tile
+    std::vector<int> abstract_path;
+    size_t abstract_index = 0;
+
+    //Tiles of the segment from abstract_path[abstract_index - 1] to abstract_path[abstract_index]
+    std::vector<int> segment;
+    size_t segment_index = 0;
+
+    bool empty() const { return abstract_path.empty(); };
+};
+
+//Abstract graph for hierarchical path finding (HPA*) on a tile grid with per tile costs
+//The grid is split in square clusters, tiles on both sides of open cluster borders become entrance nodes
+//Entrances of a cluster are connected by the cost of the fastest route that stays inside the cluster
+class ClusterGraph
+{
+  public:
+    static constexpr int cluster_size = 10;
+
+    //Costs are the cost of driving onto a tile, infinite for tiles that can not be crossed, the graph keeps a reference
+    void build(int width, int height, const std::vector<float>& costs);
+
+    //Tiles of the fastest abstract route from start to goal (both included), empty if the goal can not be reached
+    std::vector<int> find_abstract_path(int start, int goal) const;
+
+    //Appends the tiles after from up to and including to, both are consecutive tiles of an abstract route
+    void refine(int from, int to, std::vector<int>& tiles) const;
+
+    int node_count() const { return (int)node_tiles.size(); };
+
+  private:
+    struct Edge
+    {
+        int to;
+        float cost;
+    };
+
+    struct ClusterRect
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+
+        int local(int tile_x, int tile_y) const { return (tile_y - y) * width + (tile_x - x); };
+    };
+
+    ClusterRect cluster_rect(int tile) const;
+    int cluster_index(int tile) const;
+    int add_node(int tile);
+    void add_entrances(int tile_a, int tile_b, int step, int length);
+
+    //Dijkstra inside the cluster of the tile: costs from the tile to every tile of the cluster, or from every tile of the cluster to it
+    void search_cluster(int tile, bool backward, std::vector<float>& cluster_costs, std::vector<int>* parents) const;
+
+    int width = 0;
+    int height = 0;
+    int clusters_x = 0;
+    const std::vector<float>* costs = nullptr;
+
+    std::vector<int> node_tiles;
+    std::vector<int> node_of_tile;
+    std::vector<std::vector<Edge>> edges;
+    std::vector<std::vector<int>> cluster_nodes;
+    std::vector<bool> uniform_clusters;
+};
+
+} // namespace Tmpl8
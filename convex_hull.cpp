@@ -0,0 +1,180 @@
+#include "precomp.h"
+#include "convex_hull.h"
+
+namespace Tmpl8
+{
+
+//Positive when o -> a -> b turns counter clockwise
+static float cross(const vec2& o, const vec2& a, const vec2& b)
+{
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+void build_convex_hull(const vector<vec2>& sorted_points, vector<vec2>& hull, vector<int>& hull_indices)
+{
+    hull.clear();
+    hull_indices.clear();
+
+    const int num_points = (int)sorted_points.size();
+    if (num_points < 3)
+    {
+        for (int i = 0; i < num_points; i++)
+        {
+            if (i == 0 || sorted_points[i] != sorted_points[0])
+            {
+                hull.push_back(sorted_points[i]);
+                hull_indices.push_back(i);
+            }
+        }
+        return;
+    }
+
+    //Lower hull from left to right, then upper hull from right to left, popping every non left turn
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const size_t chain_start = hull_indices.size();
+
+        for (int n = 0; n < num_points; n++)
+        {
+            const int i = (pass == 0) ? n : (num_points - 1 - n);
+
+            while (hull_indices.size() >= chain_start + 2 && cross(sorted_points[hull_indices[hull_indices.size() - 2]], sorted_points[hull_indices.back()], sorted_points[i]) <= 0.f)
+            {
+                hull_indices.pop_back();
+            }
+            hull_indices.push_back(i);
+        }
+
+        //The last point of each chain is the first point of the other one
+        hull_indices.pop_back();
+    }
+
+    for (int i : hull_indices)
+    {
+        hull.push_back(sorted_points[i]);
+    }
+}
+
+//Half plane: everything left of the line through point in direction dir
+struct HalfPlane
+{
+    vec2 point;
+    vec2 dir;
+};
+
+static bool intersect_lines(const HalfPlane& a, const HalfPlane& b, vec2& intersection)
+{
+    const float denominator = a.dir.x * b.dir.y - a.dir.y * b.dir.x;
+
+    //Parallel lines or a turn of more than 180 degrees, the remaining area is empty
+    if (denominator <= 0.f) return false;
+
+    const vec2 delta = b.point - a.point;
+    const float t = (delta.x * b.dir.y - delta.y * b.dir.x) / denominator;
+    intersection = a.point + a.dir * t;
+    return true;
+}
+
+static bool outside(const HalfPlane& plane, const vec2& point)
+{
+    return (plane.dir.x * (point.y - plane.point.y) - plane.dir.y * (point.x - plane.point.x)) <= 0.f;
+}
+
+void inset_convex_hull(const vector<vec2>& hull, float margin, vector<vec2>& inset)
+{
+    inset.clear();
+
+    const int num_edges = (int)hull.size();
+    if (num_edges < 3) return;
+
+    //The edges of a convex hull are already sorted on angle, so the half plane intersection runs in linear time
+    vector<HalfPlane> planes;
+    vector<HalfPlane> deque(num_edges);
+    planes.reserve(num_edges);
+
+    for (int i = 0; i < num_edges; i++)
+    {
+        vec2 dir = hull[(i + 1) % num_edges] - hull[i];
+        const vec2 inward_normal = vec2(-dir.y, dir.x).normalized();
+        planes.push_back({ hull[i] + inward_normal * margin, dir });
+    }
+
+    int front = 0, back = 0; //deque holds [front, back)
+    vec2 corner;
+
+    for (const HalfPlane& plane : planes)
+    {
+        while (back - front >= 2)
+        {
+            if (!intersect_lines(deque[back - 2], deque[back - 1], corner)) return;
+            if (!outside(plane, corner)) break;
+            back--;
+        }
+        while (back - front >= 2)
+        {
+            if (!intersect_lines(deque[front], deque[front + 1], corner)) return;
+            if (!outside(plane, corner)) break;
+            front++;
+        }
+        deque[back++] = plane;
+    }
+
+    while (back - front >= 3)
+    {
+        if (!intersect_lines(deque[back - 2], deque[back - 1], corner)) return;
+        if (!outside(deque[front], corner)) break;
+        back--;
+    }
+    while (back - front >= 3)
+    {
+        if (!intersect_lines(deque[front], deque[front + 1], corner)) return;
+        if (!outside(deque[back - 1], corner)) break;
+        front++;
+    }
+
+    if (back - front < 3) return;
+
+    for (int i = front; i < back; i++)
+    {
+        const HalfPlane& next = (i + 1 < back) ? deque[i + 1] : deque[front];
+        if (!intersect_lines(deque[i], next, corner))
+        {
+            inset.clear();
+            return;
+        }
+        inset.push_back(corner);
+    }
+}
+
+bool point_in_convex_hull(const vector<vec2>& hull, const vec2& point, bool include_boundary)
+{
+    const int num_vertices = (int)hull.size();
+    if (num_vertices < 3) return false;
+
+    const vec2& origin = hull[0];
+
+    //Reject points outside of the fan spanned by the first and last edge
+    const float first_side = cross(origin, hull[1], point);
+    const float last_side = cross(origin, hull[num_vertices - 1], point);
+    if (include_boundary ? (first_side < 0.f || last_side > 0.f) : (first_side <= 0.f || last_side >= 0.f)) return false;
+
+    //Find the fan triangle containing the point
+    int low = 1, high = num_vertices - 1;
+    while (high - low > 1)
+    {
+        const int mid = (low + high) / 2;
+        if (cross(origin, hull[mid], point) >= 0.f)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    const float edge_side = cross(hull[low], hull[high], point);
+    return include_boundary ? (edge_side >= 0.f) : (edge_side > 0.f);
+}
+
+} // namespace Tmpl8
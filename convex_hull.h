@@ -0,0 +1,18 @@
+#pragma once
+
+namespace Tmpl8
+{
+
+//Builds the convex hull of points sorted on x (then y) using Andrew's monotone chain
+//The hull is counter clockwise (in a y-up frame) and leaves out collinear points,
+//hull_indices receives the index into sorted_points of every hull vertex
+void build_convex_hull(const vector<vec2>& sorted_points, vector<vec2>& hull, vector<int>& hull_indices);
+
+//Shrinks a convex hull by moving every edge inwards by margin, the result is empty if nothing is left
+void inset_convex_hull(const vector<vec2>& hull, float margin, vector<vec2>& inset);
+
+//Binary search over the triangle fan of the hull, O(log h)
+//On the boundary counts as inside only when include_boundary is set
+bool point_in_convex_hull(const vector<vec2>& hull, const vec2& point, bool include_boundary);
+
+} // namespace Tmpl8
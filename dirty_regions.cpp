@@ -0,0 +1,94 @@
+#include "precomp.h"
+#include "dirty_regions.h"
+
+namespace Tmpl8
+{
+void DirtyRegions::resize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    full = true;
+}
+
+bool DirtyRegions::begin_frame(Surface* screen)
+{
+    if (screen->get_width() != width || screen->get_height() != height) resize(screen->get_width(), screen->get_height());
+
+    //A different buffer (double buffered display memory) does not hold the last frame
+    const bool redraw = full || screen->get_buffer() != last_buffer;
+    last_buffer = screen->get_buffer();
+
+    restored.swap(drawn);
+    drawn.clear();
+    changed.clear();
+    if (redraw) restored.clear();
+
+    full = redraw;
+    return redraw;
+}
+
+bool DirtyRegions::clip(ScreenRect& rect) const
+{
+    rect.x1 = std::max(rect.x1, 0);
+    rect.y1 = std::max(rect.y1, 0);
+    rect.x2 = std::min(rect.x2, width);
+    rect.y2 = std::min(rect.y2, height);
+
+    return rect.x1 < rect.x2 && rect.y1 < rect.y2;
+}
+
+void DirtyRegions::add(int x1, int y1, int x2, int y2)
+{
+    ScreenRect rect{ x1, y1, x2, y2 };
+    if (clip(rect)) drawn.push_back(rect);
+}
+
+void DirtyRegions::add_changed(const ScreenRect& rect)
+{
+    ScreenRect clipped = rect;
+    if (clip(clipped)) changed.push_back(clipped);
+}
+
+bool DirtyRegions::touches(const ScreenRect& rect) const
+{
+    if (full) return true;
+
+    auto overlaps = [&rect](const ScreenRect& other) { return rect.overlaps(other); };
+    return std::any_of(restored.begin(), restored.end(), overlaps) || std::any_of(drawn.begin(), drawn.end(), overlaps) || std::any_of(changed.begin(), changed.end(), overlaps);
+}
+
+const std::vector<std::pair<int, int>>& DirtyRegions::changed_rows()
+{
+    row_runs.clear();
+    if (full)
+    {
+        if (height > 0) row_runs.emplace_back(0, height);
+        return row_runs;
+    }
+
+    row_changed.assign(height, 0);
+    for (const std::vector<ScreenRect>* rects : { &restored, &drawn, &changed })
+    {
+        for (const ScreenRect& rect : *rects)
+        {
+            std::fill(row_changed.begin() + rect.y1, row_changed.begin() + rect.y2, 1);
+        }
+    }
+
+    for (int y = 0; y < height;)
+    {
+        if (!row_changed[y])
+        {
+            y++;
+            continue;
+        }
+
+        const int first = y;
+        while (y < height && row_changed[y]) y++;
+        row_runs.emplace_back(first, y);
+    }
+
+    return row_runs;
+}
+
+} // namespace Tmpl8
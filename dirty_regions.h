@@ -0,0 +1,62 @@
+#pragma once
+
+namespace Tmpl8
+{
+//Rectangle on the screen, x2 and y2 are exclusive
+struct ScreenRect
+{
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+
+    bool overlaps(const ScreenRect& other) const { return x1 < other.x2 && other.x1 < x2 && y1 < other.y2 && other.y1 < y2; };
+};
+
+//Tracks which parts of the screen are drawn over in a frame, so the next frame only restores those parts from the background
+//Outside of the rectangles drawn in the last frame the screen still shows the background, which is what makes a partial restore enough
+//A surface reports every sprite, line, bar and text drawn on it to its dirty regions, see Surface::set_dirty_regions
+class DirtyRegions
+{
+  public:
+    //Everything changes in the first frame after a resize
+    void resize(int width, int height);
+
+    //Starts a frame on the screen, the rectangles drawn in the last frame become the ones to restore
+    //Returns true if the whole screen has to be drawn instead: on the first frame, after invalidate and when the screen buffer changed
+    bool begin_frame(Surface* screen);
+
+    //Records a rectangle that is drawn in this frame, it is restored at the start of the next one
+    void add(int x1, int y1, int x2, int y2);
+
+    //Records a rectangle that changed in this frame but is repainted by its owner instead of restored
+    void add_changed(const ScreenRect& rect);
+
+    //The whole screen changed in this frame
+    void invalidate() { full = true; };
+
+    const std::vector<ScreenRect>& get_restored() const { return restored; };
+
+    //True if the rectangle overlaps anything restored, drawn or changed in this frame
+    bool touches(const ScreenRect& rect) const;
+
+    //Runs of rows (first, last + 1) that changed in this frame, for copying only those rows to the display
+    const std::vector<std::pair<int, int>>& changed_rows();
+
+  private:
+    bool clip(ScreenRect& rect) const;
+
+    int width = 0;
+    int height = 0;
+    const Pixel* last_buffer = nullptr;
+    bool full = true;
+
+    std::vector<ScreenRect> restored;
+    std::vector<ScreenRect> drawn;
+    std::vector<ScreenRect> changed;
+
+    std::vector<uint8_t> row_changed;
+    std::vector<std::pair<int, int>> row_runs;
+};
+
+} // namespace Tmpl8
@@ -0,0 +1,33 @@
+#pragma once
+
+namespace Tmpl8
+{
+
+//Damage done to a tank, spawns a smoke plume at the tank position + smoke_offset when the tank is destroyed
+struct TankHit
+{
+    int tank;
+    int damage;
+    vec2 smoke_offset;
+};
+
+//Entities spawned and damage done by one chunk of a parallel loop
+//Every chunk writes to its own buffer and the buffers are applied in chunk order, which gives the same entity order as a serial loop
+//Buffers are kept between frames so their capacity is reused
+struct alignas(64) EventBuffer
+{
+    void clear()
+    {
+        rockets.clear();
+        explosions.clear();
+        tank_hits.clear();
+        smokes.clear();
+    }
+
+    vector<Rocket> rockets;
+    vector<vec2> explosions;
+    vector<TankHit> tank_hits;
+    vector<vec2> smokes;
+};
+
+} // namespace Tmpl8
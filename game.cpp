@@ -13,6 +13,8 @@ constexpr auto health_bar_width = 70;
 
 constexpr auto max_frames = 2000;
 
+constexpr auto path_budget_us = 250.f; //Time per frame for re-planning routes
+
 //Global performance timer
 \
 constexpr auto REF_PERFORMANCE = 445902; //UPDATE THIS WITH YOUR REFERENCE PERFORMANCE (see console after 2k frames) gebaseerd op 512 tanks
@@ -42,6 +44,20 @@ const static vec2 rocket_size(6, 6);
 const static float tank_radius = 3.f;
 const static float rocket_radius = 5.f;
 
+//Data used by the update phases, phases that share data never run at the same time
+enum UpdateData : uint32_t
+{
+    TANK_MOTION = 1 << 0,  //Positions, speeds, forces, targets and routes
+    TANK_HEALTH = 1 << 1,  //Health and active state
+    TANK_WEAPONS = 1 << 2, //Reload state and target index
+    ROCKETS = 1 << 3,
+    SMOKES = 1 << 4,
+    EXPLOSIONS = 1 << 5,
+    PARTICLE_BEAMS = 1 << 6,
+    FORCEFIELD = 1 << 7,
+    CHUNK_OUTPUTS = 1 << 8
+};
+
 // -----------------------------------------------------------
 // Initialize the simulation state
 // This function does not count for the performance multiplier
@@ -51,7 +67,27 @@ void Game::init()
 {
     frame_count_font = new Font("assets/digital_small.png", "ABCDEFGHIJKLMNOPQRSTUVWXYZ:?!=-0123456789.");
 
+    tank_system.reserve(num_tanks_blue + num_tanks_red);
     tanks.reserve(num_tanks_blue + num_tanks_red);
+    rockets.reserve((num_tanks_blue + num_tanks_red) * 2); //Every tank can have about two rockets in flight
+    explosions.reserve(num_tanks_blue + num_tanks_red);
+    smokes.reserve(num_tanks_blue + num_tanks_red); //At most one smoke plume per destroyed tank
+
+    forcefield_order.reserve(num_tanks_blue + num_tanks_red);
+    forcefield_points.reserve(num_tanks_blue + num_tanks_red);
+    forcefield_hull.reserve(num_tanks_blue + num_tanks_red);
+    forcefield_inset.reserve(num_tanks_blue + num_tanks_red);
+    forcefield_hull_tanks.reserve(num_tanks_blue + num_tanks_red);
+    forcefield_hull_points.reserve(num_tanks_blue + num_tanks_red);
+
+    //The calling thread works along on every parallel loop
+    thread_pool = std::make_unique<ThreadPool>(thread_count - 1);
+    build_update_graph();
+
+    //Routes are read from the precomputed next hop table, it is only built when the terrain changed
+    hierarchical_routes = hierarchical_routes || background_terrain.prefers_hierarchical_routes();
+    if (!hierarchical_routes) background_terrain.load_next_hop_table(*thread_pool);
+    else background_terrain.prepare_hierarchical_routes();
 
     uint max_rows = 24;
 
@@ -67,13 +103,13 @@ void Game::init()
     for (int i = 0; i < num_tanks_blue; i++)
     {
         vec2 position{ start_blue_x + ((i % max_rows) * spacing), start_blue_y + ((i / max_rows) * spacing) };
-        tanks.push_back(Tank(position.x, position.y, BLUE, &tank_blue, &smoke, 1100.f, position.y + 16, tank_radius, tank_max_health, tank_max_speed));
+        tanks.push_back(Tank(tank_system, position.x, position.y, BLUE, &tank_blue, &smoke, 1100.f, position.y + 16, tank_radius, tank_max_health, tank_max_speed));
     }
     //Spawn red tanks
     for (int i = 0; i < num_tanks_red; i++)
     {
         vec2 position{ start_red_x + ((i % max_rows) * spacing), start_red_y + ((i / max_rows) * spacing) };
-        tanks.push_back(Tank(position.x, position.y, RED, &tank_red, &smoke, 100.f, position.y + 16, tank_radius, tank_max_health, tank_max_speed));
+        tanks.push_back(Tank(tank_system, position.x, position.y, RED, &tank_red, &smoke, 100.f, position.y + 16, tank_radius, tank_max_health, tank_max_speed));
     }
 
     particle_beams.push_back(Particle_beam(vec2(590, 327), vec2(100, 50), &particle_beam_sprite, particle_beam_hit_value));
@@ -89,33 +125,167 @@ void Game::shutdown()
 }
 
 // -----------------------------------------------------------
-// Iterates through all tanks and returns the closest enemy tank for the given tank
+// Returns the closest enemy tank for the given tank
+// Queries the k-d trees of the other teams, gives the same result as a linear scan over all tanks
+// The trees have to be built for the current tank positions, queries may run concurrently
 // -----------------------------------------------------------
 Tank& Game::find_closest_enemy(Tank& current_tank)
 {
     float closest_distance = numeric_limits<float>::infinity();
     int closest_index = 0;
 
-    for (int i = 0; i < tanks.size(); i++)
+    for (int team = 0; team < (int)team_trees.size(); team++)
     {
-        if (tanks.at(i).allignment != current_tank.allignment && tanks.at(i).active)
+        if (team != current_tank.allignment)
         {
-            float sqr_dist = fabsf((tanks.at(i).get_position() - current_tank.get_position()).sqr_length());
-            if (sqr_dist < closest_distance)
-            {
-                closest_distance = sqr_dist;
-                closest_index = i;
-            }
+            team_trees.at(team).find_nearest(current_tank.get_position(), closest_index, closest_distance);
         }
     }
 
     return tanks.at(closest_index);
 }
 
-//Checks if a point lies on the left of an arbitrary angled line
-bool Tmpl8::Game::left_of_line(vec2 line_start, vec2 line_end, vec2 point)
+// -----------------------------------------------------------
+// Checks if the current forcefield still wraps all active tanks exactly
+// -----------------------------------------------------------
+bool Game::forcefield_outdated() const
+{
+    if (forcefield_hull_tanks.empty()) return true;
+
+    for (size_t i = 0; i < forcefield_hull_tanks.size(); i++)
+    {
+        const Tank& tank = tanks[forcefield_hull_tanks[i]];
+        if (!tank.is_active() || tank.get_position() != forcefield_hull[i]) return true;
+    }
+
+    //Interior tanks may move freely as long as they stay within the hull
+    for (int tank_index : tank_system.live_tanks())
+    {
+        if (!point_in_convex_hull(forcefield_hull, tanks[tank_index].get_position(), true)) return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------
+// Calculate the convex hull around all active tanks for the 'rocket barrier'
+// -----------------------------------------------------------
+void Game::build_forcefield()
+{
+    if (forcefield_order.empty())
+    {
+        forcefield_order = tank_system.live_tanks();
+    }
+
+    forcefield_order.erase(std::remove_if(forcefield_order.begin(), forcefield_order.end(), [this](int i) { return !tanks[i].is_active(); }), forcefield_order.end());
+
+    //Tanks only move a little each frame, so insertion sort on last frames order is close to linear
+    for (size_t i = 1; i < forcefield_order.size(); i++)
+    {
+        const int tank_index = forcefield_order[i];
+        const vec2 position = tanks[tank_index].get_position();
+
+        size_t j = i;
+        for (; j > 0; j--)
+        {
+            const vec2 other = tanks[forcefield_order[j - 1]].get_position();
+            if (other.x < position.x || (other.x == position.x && other.y <= position.y)) break;
+            forcefield_order[j] = forcefield_order[j - 1];
+        }
+        forcefield_order[j] = tank_index;
+    }
+
+    forcefield_points.clear();
+    for (int tank_index : forcefield_order)
+    {
+        forcefield_points.push_back(tanks[tank_index].get_position());
+    }
+
+    build_convex_hull(forcefield_points, forcefield_hull, forcefield_hull_points);
+
+    forcefield_hull_tanks.clear();
+    for (int point_index : forcefield_hull_points)
+    {
+        forcefield_hull_tanks.push_back(forcefield_order[point_index]);
+    }
+
+    inset_convex_hull(forcefield_hull, rocket_radius, forcefield_inset);
+}
+
+// -----------------------------------------------------------
+// Per chunk outputs are kept between frames so their buffers are reused
+// -----------------------------------------------------------
+int Game::prepare_chunk_outputs(int count, int grain)
+{
+    const int chunk_count = (count + grain - 1) / grain;
+    if ((int)chunk_outputs.size() < chunk_count)
+    {
+        chunk_outputs.resize(chunk_count);
+    }
+    return chunk_count;
+}
+
+// -----------------------------------------------------------
+// Rockets and explosions are spawned first, then hits are applied (a hit on a tank that is already destroyed is dropped)
+// -----------------------------------------------------------
+void Game::apply_events(int chunk_count)
+{
+    for (int chunk = 0; chunk < chunk_count; chunk++)
+    {
+        const EventBuffer& events = chunk_outputs[chunk].events;
+
+        for (const Rocket& rocket : events.rockets)
+        {
+            rockets.add(rocket);
+        }
+
+        for (vec2 position : events.explosions)
+        {
+            explosions.spawn(&explosion, position);
+        }
+
+        for (const TankHit& tank_hit : events.tank_hits)
+        {
+            Tank& tank = tanks[tank_hit.tank];
+            if (tank.is_active() && tank.hit(tank_hit.damage))
+            {
+                smokes.spawn(smoke, tank.get_position() + tank_hit.smoke_offset);
+            }
+        }
+
+        for (vec2 position : events.smokes)
+        {
+            smokes.spawn(smoke, position);
+        }
+    }
+}
+
+// -----------------------------------------------------------
+// Re-plan the routes of the tanks within the path budget
+// -----------------------------------------------------------
+void Game::replan_routes()
 {
-    return ((line_end.x - line_start.x) * (point.y - line_start.y) - (line_end.y - line_start.y) * (point.x - line_start.x)) < 0;
+    //Every live tank asks for a route once per interval, from the waypoint it is driving to
+    for (int i : tank_system.live_tanks())
+    {
+        if ((i + frame_count) % replan_interval == 0)
+        {
+            path_requests.request(i, background_terrain.tile_index(tanks[i].get_target()), background_terrain.tile_index(tanks[i].get_destination()));
+        }
+    }
+
+    //Tanks keep driving their old route until the new one is ready
+    path_results.clear();
+    path_requests.process(background_terrain, path_budget_us, path_results);
+
+    for (PathRequests::Result& result : path_results)
+    {
+        if (tanks[result.tank].is_active() && !result.route.empty())
+        {
+            tanks[result.tank].replace_route(std::move(result.route), background_terrain);
+            replanned_routes++;
+        }
+    }
 }
 
 // -----------------------------------------------------------
@@ -127,188 +297,313 @@ bool Tmpl8::Game::left_of_line(vec2 line_start, vec2 line_end, vec2 point)
 // -----------------------------------------------------------
 void Game::update(float deltaTime)
 {
-    //Calculate the route to the destination for each tank using BFS
+    //Let each tank follow the flow field of its destination, tanks with the same destination tile share one field
+    //On big maps the tanks plan hierarchical routes instead and refine them while driving, tanks that re-plan get tile routes
     //Initializing routes here so it gets counted for performance..
-    if (frame_count == 0)
+    if (frame_count == 0 && hierarchical_routes)
     {
-        for (Tank& t : tanks)
+        thread_pool->parallel_for(0, (int)tanks.size(), 8, [this](int begin, int end) {
+            for (int i = begin; i < end; i++)
+            {
+                HierarchicalRoute route;
+                background_terrain.plan_route(route, tanks[i].get_position(), tanks[i].get_target());
+                tanks[i].follow(std::move(route), background_terrain);
+            }
+        });
+    }
+    else if (frame_count == 0 && replan_interval > 0)
+    {
+        //Tanks that re-plan drive tile routes from the start, so a new route replaces one of the same kind
+        vector<vector<int>> routes = background_terrain.get_routes(tanks, *thread_pool);
+        for (size_t i = 0; i < tanks.size(); i++)
         {
-            t.set_route(background_terrain.get_route(t, t.target));
+            tanks[i].follow(routes[i].empty() ? HierarchicalRoute() : HierarchicalRoute::from_tiles(std::move(routes[i])), background_terrain);
         }
     }
-
-    //Check tank collision and nudge tanks away from each other
-    for (Tank& tank : tanks)
+    else if (frame_count == 0)
     {
-        if (tank.active)
+        vector<vec2> destinations;
+        destinations.reserve(tanks.size());
+        for (const Tank& t : tanks) destinations.push_back(t.get_target());
+
+        //The distinct fields are computed in parallel
+        const vector<const FlowField*> flow_fields = background_terrain.get_flow_fields(destinations, *thread_pool);
+        for (size_t i = 0; i < tanks.size(); i++)
         {
-            for (Tank& other_tank : tanks)
-            {
-                if (&tank == &other_tank || !other_tank.active) continue;
+            tanks[i].follow(flow_fields[i], background_terrain);
+        }
+    }
 
-                vec2 dir = tank.get_position() - other_tank.get_position();
-                float dir_squared_len = dir.sqr_length();
+    if (replan_interval > 0 && frame_count > 0) replan_routes();
 
-                float col_squared_len = (tank.get_collision_radius() + other_tank.get_collision_radius());
-                col_squared_len *= col_squared_len;
+    //Phases that use different data overlap, see build_update_graph
+    const int allocations_before = pool_allocations();
+    update_graph.run(*thread_pool);
 
-                if (dir_squared_len < col_squared_len)
-                {
-                    tank.push(dir.normalized(), 1.f);
-                }
+    frame_pool_allocations = pool_allocations() - allocations_before;
+    if (frame_count > 0) battle_pool_allocations += frame_pool_allocations;
+
+    if (trace_frames)
+    {
+        std::cout << "frame " << frame_count << " (" << frame_pool_allocations << " pool allocations): ";
+        update_graph.print_trace(std::cout);
+    }
+}
+
+// -----------------------------------------------------------
+// Declares the update phases in the order they used to run with the data they use
+// Phases wait for the earlier phases they share data with, so the result is the same as running them one by one
+// -----------------------------------------------------------
+void Game::build_update_graph()
+{
+    update_graph.add("nudge tanks", TANK_HEALTH, TANK_MOTION | CHUNK_OUTPUTS, [this]() { nudge_tanks(); });
+    update_graph.add("move tanks", TANK_HEALTH, TANK_MOTION | TANK_WEAPONS, [this]() { move_tanks(); });
+    update_graph.add("shoot", TANK_MOTION | TANK_HEALTH, TANK_WEAPONS | ROCKETS | CHUNK_OUTPUTS, [this]() { shoot(); });
+    update_graph.add("smoke tick", 0, SMOKES, [this]() { tick_smokes(); });
+    update_graph.add("forcefield", TANK_MOTION | TANK_HEALTH, FORCEFIELD, [this]() { update_forcefield(); });
+    update_graph.add("rocket tick", 0, ROCKETS, [this]() { tick_rockets(); });
+    update_graph.add("rocket hits", TANK_MOTION, TANK_HEALTH | ROCKETS | EXPLOSIONS | SMOKES | CHUNK_OUTPUTS, [this]() { hit_tanks_with_rockets(); });
+    update_graph.add("forcefield rockets", FORCEFIELD, ROCKETS | EXPLOSIONS | CHUNK_OUTPUTS, [this]() { stop_rockets_at_forcefield(); });
+    update_graph.add("beam animation", 0, PARTICLE_BEAMS, [this]() { tick_particle_beams(); });
+    update_graph.add("beam damage", PARTICLE_BEAMS | TANK_MOTION, TANK_HEALTH | SMOKES | CHUNK_OUTPUTS, [this]() { damage_tanks_with_beams(); });
+    update_graph.add("explosion tick", 0, EXPLOSIONS, [this]() { tick_explosions(); });
+}
+
+void Game::nudge_tanks()
+{
+    //Check tank collision and nudge tanks away from each other
+    //Only tanks in the neighbouring grid cells can overlap, so rebuild the grid and query that instead of all pairs
+    const vector<int>& live_tanks = tank_system.live_tanks();
+    tank_grid.build(tanks, live_tanks);
+
+    prepare_chunk_outputs((int)live_tanks.size(), nudge_grain.size());
+    thread_pool->parallel_for(0, (int)live_tanks.size(), nudge_grain, [this, &live_tanks, grain = nudge_grain.size()](int begin, int end) {
+        vector<int>& colliding_tanks = chunk_outputs[begin / grain].colliding_tanks;
+
+        for (int l = begin; l < end; l++)
+        {
+            const int i = live_tanks[l];
+            Tank& tank = tanks[i];
+
+            tank_grid.find_colliding(tanks, i, colliding_tanks);
+
+            for (int other_index : colliding_tanks)
+            {
+                vec2 dir = tank.get_position() - tanks[other_index].get_position();
+                tank.push(dir.normalized(), 1.f);
             }
         }
-    }
+    });
+}
 
-    //Update tanks
-    for (Tank& tank : tanks)
-    {
-        if (tank.active)
+void Game::move_tanks()
+{
+    //Move tanks according to speed and nudges (see above), 8 tanks at a time, blocks without live tanks are skipped
+    thread_pool->parallel_for(0, (int)tanks.size(), move_grain, [this](int begin, int end) { tank_system.move(begin, end); });
+
+    //Update tanks (reload, animation and route)
+    const vector<int>& live_tanks = tank_system.live_tanks();
+    thread_pool->parallel_for(0, (int)live_tanks.size(), tick_grain, [this, &live_tanks](int begin, int end) {
+        for (int l = begin; l < end; l++)
         {
-            //Move tanks according to speed and nudges (see above) also reload
-            tank.tick(background_terrain);
+            tanks[live_tanks[l]].tick(background_terrain);
+        }
+    });
+}
+
+void Game::shoot()
+{
+    const vector<int>& live_tanks = tank_system.live_tanks();
+
+    //Tanks moved, the target index has to be rebuilt before it is queried again
+    const bool any_reloaded = thread_pool->parallel_reduce(
+        0, (int)live_tanks.size(), 256, false,
+        [this, &live_tanks](int begin, int end) { return std::any_of(live_tanks.begin() + begin, live_tanks.begin() + end, [this](int i) { return tanks[i].rocket_reloaded(); }); },
+        [](bool a, bool b) { return a || b; });
+
+    if (any_reloaded)
+    {
+        team_trees.at(BLUE).build(tanks, tank_system.live_tanks(BLUE));
+        team_trees.at(RED).build(tanks, tank_system.live_tanks(RED));
+    }
 
-            //Shoot at closest target if reloaded
+    //Shoot at closest target if reloaded, rockets are added in tank order afterwards
+    const int shoot_chunks = prepare_chunk_outputs((int)live_tanks.size(), shoot_grain.size());
+    thread_pool->parallel_for(0, (int)live_tanks.size(), shoot_grain, [this, &live_tanks, grain = shoot_grain.size()](int begin, int end) {
+        EventBuffer& events = chunk_outputs[begin / grain].events;
+        events.clear();
+
+        for (int l = begin; l < end; l++)
+        {
+            Tank& tank = tanks[live_tanks[l]];
             if (tank.rocket_reloaded())
             {
                 Tank& target = find_closest_enemy(tank);
 
-                rockets.push_back(Rocket(tank.position, (target.get_position() - tank.position).normalized() * 3, rocket_radius, tank.allignment, ((tank.allignment == RED) ? &rocket_red : &rocket_blue)));
+                events.rockets.push_back(Rocket(tank.get_position(), (target.get_position() - tank.get_position()).normalized() * 3, rocket_radius, tank.allignment, ((tank.allignment == RED) ? &rocket_red : &rocket_blue)));
 
                 tank.reload_rocket();
             }
         }
-    }
+    });
 
+    apply_events(shoot_chunks);
+}
+
+void Game::tick_smokes()
+{
     //Update smoke plumes
     for (Smoke& smoke : smokes)
     {
         smoke.tick();
     }
+}
 
+void Game::update_forcefield()
+{
     //Calculate "forcefield" around active tanks
-    forcefield_hull.clear();
-
-    //Find first active tank (this loop is a bit disgusting, fix?)
-    int first_active = 0;
-    for (Tank& tank : tanks)
+    if (forcefield_outdated())
     {
-        if (tank.active)
-        {
-            break;
-        }
-        first_active++;
+        build_forcefield();
     }
-    vec2 point_on_hull = tanks.at(first_active).position;
-    //Find left most tank position
-    for (Tank& tank : tanks)
+}
+
+void Game::tick_rockets()
+{
+    //Update rockets
+    thread_pool->parallel_for(0, rockets.size(), rocket_grain, [this](int begin, int end) { rockets.tick(begin, end); });
+}
+
+void Game::hit_tanks_with_rockets()
+{
+    //Check if rocket collides with enemy tank, spawn explosion, and if tank is destroyed spawn a smoke plume
+    //Rockets are handled in order and hit the first tank that is still active, earlier rockets may have destroyed some
+    const vector<int>& live_tanks = tank_system.live_tanks();
+    const int collision_chunks = prepare_chunk_outputs((int)live_tanks.size(), collision_grain.size());
+    thread_pool->parallel_for(0, (int)live_tanks.size(), collision_grain, [this, &live_tanks, grain = collision_grain.size()](int begin, int end) {
+        vector<std::pair<int, int>>& collisions = chunk_outputs[begin / grain].rocket_collisions;
+        collisions.clear();
+
+        rockets.find_collisions(tanks, live_tanks.data() + begin, end - begin, collisions);
+    });
+
+    rocket_collisions.clear();
+    for (int chunk = 0; chunk < collision_chunks; chunk++)
     {
-        if (tank.active)
-        {
-            if (tank.position.x <= point_on_hull.x)
-            {
-                point_on_hull = tank.position;
-            }
-        }
+        const vector<std::pair<int, int>>& collisions = chunk_outputs[chunk].rocket_collisions;
+        rocket_collisions.insert(rocket_collisions.end(), collisions.begin(), collisions.end());
     }
+    rockets.group_collisions(rocket_collisions);
+
+    //Whether a tank is still active depends on the hits of all earlier rockets, so hits are resolved on this thread
+    //Spawned entities still go through an event buffer so they are added in one go
+    EventBuffer& events = chunk_outputs[0].events;
+    events.clear();
 
-    //Calculate convex hull for 'rocket barrier'
-    for (Tank& tank : tanks)
+    for (int i = 0; i < rockets.size(); i++)
     {
-        if (tank.active)
+        for (int c = rockets.collision_start[i]; c < rockets.collision_start[i + 1]; c++)
         {
-            forcefield_hull.push_back(point_on_hull);
-            vec2 endpoint = tanks.at(first_active).position;
+            Tank& tank = tanks[rockets.collision_tanks[c]];
+            if (!tank.is_active()) continue;
 
-            for (Tank& tank : tanks)
-            {
-                if (tank.active)
-                {
-                    if ((endpoint == point_on_hull) || left_of_line(point_on_hull, endpoint, tank.position))
-                    {
-                        endpoint = tank.position;
-                    }
-                }
-            }
-            point_on_hull = endpoint;
+            events.explosions.push_back(tank.get_position());
 
-            if (endpoint == forcefield_hull.at(0))
+            if (tank.hit(rocket_hit_value))
             {
-                break;
+                events.smokes.push_back(tank.get_position() - vec2(7, 24));
             }
+
+            rockets.deactivate(i);
+            break;
         }
     }
 
-    //Update rockets
-    for (Rocket& rocket : rockets)
-    {
-        rocket.tick();
+    apply_events(1);
+}
 
-        //Check if rocket collides with enemy tank, spawn explosion, and if tank is destroyed spawn a smoke plume
-        for (Tank& tank : tanks)
+void Game::stop_rockets_at_forcefield()
+{
+    //Disable rockets if they collide with the "forcefield" or are outside of it
+    //A rocket touches the hull exactly when its center is not inside the hull shrunk by its radius
+    //Without an inset (fewer than 3 hull tanks or a formation thinner than a rocket) the hull edges are tested one by one
+    const bool has_inset = forcefield_inset.size() >= 3;
+    auto hits_forcefield = [this, has_inset](const vec2& position) {
+        if (has_inset) return !point_in_convex_hull(forcefield_inset, position, false);
+
+        for (size_t i = 0; i < forcefield_hull.size(); i++)
         {
-            if (tank.active && (tank.allignment != rocket.allignment) && rocket.intersects(tank.position, tank.collision_radius))
-            {
-                explosions.push_back(Explosion(&explosion, tank.position));
-
-                if (tank.hit(rocket_hit_value))
-                {
-                    smokes.push_back(Smoke(smoke, tank.position - vec2(7, 24)));
-                }
-
-                rocket.active = false;
-                break;
-            }
+            if (circle_segment_intersect(forcefield_hull[i], forcefield_hull[(i + 1) % forcefield_hull.size()], position, rocket_radius)) return true;
         }
-    }
+        return false;
+    };
 
-    //Disable rockets if they collide with the "forcefield"
-    //Hint: A point to convex hull intersection test might be better here? :) (Disable if outside)
-    for (Rocket& rocket : rockets)
-    {
-        if (rocket.active)
+    const int forcefield_chunks = prepare_chunk_outputs(rockets.size(), forcefield_grain.size());
+    thread_pool->parallel_for(0, rockets.size(), forcefield_grain, [this, &hits_forcefield, grain = forcefield_grain.size()](int begin, int end) {
+        EventBuffer& events = chunk_outputs[begin / grain].events;
+        events.clear();
+
+        for (int i = begin; i < end; i++)
         {
-            for (size_t i = 0; i < forcefield_hull.size(); i++)
+            if (rockets.is_active(i) && hits_forcefield(rockets.get_position(i)))
             {
-                if (circle_segment_intersect(forcefield_hull.at(i), forcefield_hull.at((i + 1) % forcefield_hull.size()), rocket.position, rocket.collision_radius))
-                {
-                    explosions.push_back(Explosion(&explosion, rocket.position));
-                    rocket.active = false;
-                }
+                events.explosions.push_back(rockets.get_position(i));
+                rockets.deactivate(i);
             }
         }
-    }
-
+    });
 
+    apply_events(forcefield_chunks);
 
-    //Remove exploded rockets with remove erase idiom
-    rockets.erase(std::remove_if(rockets.begin(), rockets.end(), [](const Rocket& rocket) { return !rocket.active; }), rockets.end());
+    //Remove exploded rockets
+    rockets.remove_inactive();
+}
 
-    //Update particle beams
+void Game::tick_particle_beams()
+{
+    //Update particle beam animations
     for (Particle_beam& particle_beam : particle_beams)
     {
         particle_beam.tick(tanks);
+    }
+}
 
+void Game::damage_tanks_with_beams()
+{
+    for (Particle_beam& particle_beam : particle_beams)
+    {
         //Damage all tanks within the damage window of the beam (the window is an axis-aligned bounding box)
-        for (Tank& tank : tanks)
-        {
-            if (tank.active && particle_beam.rectangle.intersects_circle(tank.get_position(), tank.get_collision_radius()))
+        //Every tank is hit at most once per beam, so recording the hits and applying them in tank order afterwards changes nothing
+        const vector<int>& live_tanks = tank_system.live_tanks();
+        const int beam_chunks = prepare_chunk_outputs((int)live_tanks.size(), beam_grain.size());
+        thread_pool->parallel_for(0, (int)live_tanks.size(), beam_grain, [this, &particle_beam, &live_tanks, grain = beam_grain.size()](int begin, int end) {
+            EventBuffer& events = chunk_outputs[begin / grain].events;
+            events.clear();
+
+            for (int l = begin; l < end; l++)
             {
-                if (tank.hit(particle_beam.damage))
+                const int i = live_tanks[l];
+                const Tank& tank = tanks[i];
+                if (particle_beam.rectangle.intersects_circle(tank.get_position(), tank.get_collision_radius()))
                 {
-                    smokes.push_back(Smoke(smoke, tank.position - vec2(0, 48)));
+                    events.tank_hits.push_back({ i, particle_beam.damage, vec2(0, -48) });
                 }
             }
-        }
+        });
+
+        apply_events(beam_chunks);
     }
+}
 
-    //Update explosion sprites and remove when done with remove erase idiom
+void Game::tick_explosions()
+{
+    //Update explosion sprites and retire them when done
     for (Explosion& explosion : explosions)
     {
         explosion.tick();
     }
 
-    explosions.erase(std::remove_if(explosions.begin(), explosions.end(), [](const Explosion& explosion) { return explosion.done(); }), explosions.end());
+    explosions.retire_if([](const Explosion& explosion) { return explosion.done(); });
 }
 
 // -----------------------------------------------------------
@@ -317,23 +612,30 @@ void Game::update(float deltaTime)
 // -----------------------------------------------------------
 void Game::draw()
 {
-    // clear the graphics window
-    screen->clear(0);
-
-    //Draw background
-    background_terrain.draw(screen);
-
-    //Draw sprites
-    for (int i = 0; i < num_tanks_blue + num_tanks_red; i++)
+    //Restore the background where the last frame drew, everywhere else the screen still shows it
+    //The whole background is copied on the first frame, after it changed and when the screen buffer is a different one
+    if (dirty_regions.begin_frame(screen) || background_terrain.background_changed(screen))
+    {
+        background_terrain.draw(screen);
+        dirty_regions.invalidate();
+    }
+    else
     {
-        tanks.at(i).draw(screen);
+        for (const ScreenRect& rect : dirty_regions.get_restored())
+        {
+            background_terrain.restore(screen, rect);
+        }
+    }
 
-        vec2 tank_pos = tanks.at(i).get_position();
+    //Draw sprites, destroyed tanks are marked by their smoke plume
+    for (int i : tank_system.live_tanks())
+    {
+        tanks[i].draw(screen);
     }
 
-    for (Rocket& rocket : rockets)
+    for (int i = 0; i < rockets.size(); i++)
     {
-        rocket.draw(screen);
+        rockets.get(i).draw(screen);
     }
 
     for (Smoke& smoke : smokes)
@@ -364,57 +666,47 @@ void Game::draw()
     //Draw sorted health bars
     for (int t = 0; t < 2; t++)
     {
-        const int NUM_TANKS = ((t < 1) ? num_tanks_blue : num_tanks_red);
-
-        const int begin = ((t < 1) ? 0 : num_tanks_blue);
-        std::vector<const Tank*> sorted_tanks;
-        insertion_sort_tanks_health(tanks, sorted_tanks, begin, begin + NUM_TANKS);
-        sorted_tanks.erase(std::remove_if(sorted_tanks.begin(), sorted_tanks.end(), [](const Tank* tank) { return !tank->active; }), sorted_tanks.end());
-
-        draw_health_bars(sorted_tanks, t);
+        draw_health_bars(lowest_health_values(t), t);
     }
 }
 
 // -----------------------------------------------------------
-// Sort tanks by health value using insertion sort
+// Health values of the <SCRHEIGHT> least healthy active tanks of a team, lowest first
+// Read from the health index, and only when a tank was hit since the last call
 // -----------------------------------------------------------
-void Tmpl8::Game::insertion_sort_tanks_health(const std::vector<Tank>& original, std::vector<const Tank*>& sorted_tanks, int begin, int end)
+const std::vector<int>& Tmpl8::Game::lowest_health_values(const int team)
 {
-    const int NUM_TANKS = end - begin;
-    sorted_tanks.reserve(NUM_TANKS);
-    sorted_tanks.emplace_back(&original.at(begin));
+    const HealthIndex& health_index = tank_system.health_index;
 
-    for (int i = begin + 1; i < (begin + NUM_TANKS); i++)
+    if (health_bar_versions[team] != health_index.version())
     {
-        const Tank& current_tank = original.at(i);
+        std::vector<int>& values = health_bar_values[team];
+        values.clear();
+        health_index.for_lowest(team, SCRHEIGHT, [&values](int, int health) { values.push_back(health); });
 
-        for (int s = (int)sorted_tanks.size() - 1; s >= 0; s--)
-        {
-            const Tank* current_checking_tank = sorted_tanks.at(s);
-
-            if ((current_checking_tank->compare_health(current_tank) <= 0))
-            {
-                sorted_tanks.insert(1 + sorted_tanks.begin() + s, &current_tank);
-                break;
-            }
-
-            if (s == 0)
-            {
-                sorted_tanks.insert(sorted_tanks.begin(), &current_tank);
-                break;
-            }
-        }
+        health_bar_versions[team] = health_index.version();
     }
+
+    return health_bar_values[team];
 }
 
 // -----------------------------------------------------------
-// Draw the health bars based on the given tanks health values
+// Draw the health bars based on the given health values
 // -----------------------------------------------------------
-void Tmpl8::Game::draw_health_bars(const std::vector<const Tank*>& sorted_tanks, const int team)
+void Tmpl8::Game::draw_health_bars(const std::vector<int>& sorted_health, const int team)
 {
     int health_bar_start_x = (team < 1) ? 0 : (SCRWIDTH - HEALTHBAR_OFFSET) - 1;
     int health_bar_end_x = (team < 1) ? health_bar_width : health_bar_start_x + health_bar_width - 1;
 
+    //The bars paint their whole column, so they are drawn again instead of restored from the background
+    //That is only needed when the health changed or something was restored or drawn over the column
+    const ScreenRect column{ health_bar_start_x, 0, health_bar_end_x + 1, SCRHEIGHT };
+    if (health_bars_drawn[team] == health_bar_versions[team] && !dirty_regions.touches(column)) return;
+
+    health_bars_drawn[team] = health_bar_versions[team];
+    dirty_regions.add_changed(column);
+    screen->set_dirty_regions(nullptr);
+
     for (int i = 0; i < SCRHEIGHT - 1; i++)
     {
         //Health bars are 1 pixel each
@@ -425,18 +717,20 @@ void Tmpl8::Game::draw_health_bars(const std::vector<const Tank*>& sorted_tanks,
     }
 
     //Draw the <SCRHEIGHT> least healthy tank health bars
-    int draw_count = std::min(SCRHEIGHT, (int)sorted_tanks.size());
+    int draw_count = std::min(SCRHEIGHT, (int)sorted_health.size());
     for (int i = 0; i < draw_count - 1; i++)
     {
         //Health bars are 1 pixel each
         int health_bar_start_y = i * 1;
         int health_bar_end_y = health_bar_start_y + 1;
 
-        float health_fraction = (1 - ((double)sorted_tanks.at(i)->health / (double)tank_max_health));
+        float health_fraction = (1 - ((double)sorted_health[i] / (double)tank_max_health));
 
         if (team == 0) { screen->bar(health_bar_start_x + (int)((double)health_bar_width * health_fraction), health_bar_start_y, health_bar_end_x, health_bar_end_y, GREENMASK); }
         else { screen->bar(health_bar_start_x, health_bar_start_y, health_bar_end_x - (int)((double)health_bar_width * health_fraction), health_bar_end_y, GREENMASK); }
     }
+
+    screen->set_dirty_regions(&dirty_regions);
 }
 
 // -----------------------------------------------------------
@@ -453,6 +747,7 @@ void Tmpl8::Game::measure_performance()
         {
             duration = perf_timer.elapsed();
             cout << "Duration was: " << duration << " (Replace REF_PERFORMANCE with this value)" << endl;
+            cout << "Pool allocations after the first frame: " << battle_pool_allocations << endl;
             lock_update = true;
         }
 
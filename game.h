@@ -11,14 +11,27 @@ class Particle_beam;
 class Game
 {
   public:
-    void set_target(Surface* surface) { screen = surface; }
+    //The screen reports what is drawn on it, so the next frame only restores and uploads what changed
+    void set_target(Surface* surface) { screen = surface; screen->set_dirty_regions(&dirty_regions); dirty_regions.resize(surface->get_width(), surface->get_height()); }
+    //Rows of the screen that changed in the last tick, only those have to be copied to the display
+    const std::vector<std::pair<int, int>>& changed_rows() { return dirty_regions.changed_rows(); }
+    //Number of threads that run the update, including the calling thread. Call before init
+    void set_thread_count(int count) { thread_count = std::max(count, 1); }
+    //Print the timings of the update phases every frame
+    void set_trace_frames(bool enabled) { trace_frames = enabled; }
+    //Route with hierarchical path finding even if the map is small enough for flow fields. Call before init
+    void set_hierarchical_routes(bool enabled) { hierarchical_routes = enabled; }
+    //Give every tank a new route every interval frames, 0 never re-plans
+    void set_replan_interval(int frames) { replan_interval = std::max(frames, 0); }
+    //Number of re-planned routes the tanks switched to
+    int replanned_route_count() const { return replanned_routes; }
     void init();
     void shutdown();
     void update(float deltaTime);
     void draw();
     void tick(float deltaTime);
-    void insertion_sort_tanks_health(const std::vector<Tank>& original, std::vector<const Tank*>& sorted_tanks, int begin, int end);
-    void draw_health_bars(const std::vector<const Tank*>& sorted_tanks, const int team);
+    const std::vector<int>& lowest_health_values(const int team);
+    void draw_health_bars(const std::vector<int>& sorted_health, const int team);
     void measure_performance();
 
     Tank& find_closest_enemy(Tank& current_tank);
@@ -44,24 +57,103 @@ class Game
     }
 
   private:
+    //Results of one chunk of a parallel loop, merged in chunk order afterwards so the outcome does not depend on the chunking
+    //Aligned to a cache line so threads never write to the same line
+    struct alignas(64) ChunkOutput
+    {
+        EventBuffer events;
+        vector<int> colliding_tanks;
+        vector<std::pair<int, int>> rocket_collisions;
+    };
+
     Surface* screen;
 
+    TankSystem tank_system;
     vector<Tank> tanks;
-    vector<Rocket> rockets;
-    vector<Smoke> smokes;
-    vector<Explosion> explosions;
+    RocketSystem rockets;
+    ObjectPool<Smoke> smokes;
+    ObjectPool<Explosion> explosions;
     vector<Particle_beam> particle_beams;
 
+    TankGrid tank_grid;
+
+    //Health values shown in the health bars per team, refreshed when the health index changed
+    std::array<std::vector<int>, 2> health_bar_values;
+    std::array<uint32_t, 2> health_bar_versions = { ~0u, ~0u };
+    std::array<uint32_t, 2> health_bars_drawn = { ~0u, ~0u };
+    DirtyRegions dirty_regions;
+
+    //Nearest neighbour index per team, rebuilt before the tanks shoot
+    std::array<KdTree, 2> team_trees;
+
+    int thread_count = std::max((int)std::thread::hardware_concurrency(), 1);
+    std::unique_ptr<ThreadPool> thread_pool;
+    TaskGraph update_graph;
+    bool trace_frames = false;
+    bool hierarchical_routes = false;
+    int replan_interval = 0;
+    int replanned_routes = 0;
+
+    //Pool allocations in the last frame and in all frames after the first
+    int frame_pool_allocations = 0;
+    int battle_pool_allocations = 0;
+    int pool_allocations() const { return smokes.allocations() + explosions.allocations() + rockets.allocations(); }
+    vector<ChunkOutput> chunk_outputs;
+
+    //Chunk sizes of the parallel loops, the forcefield loop deactivates rockets so it uses multiples of 64 to never share an active bit word
+    //Tank movement runs over index ranges in blocks of 8 and also uses multiples of 64, the other tank loops run over the live tanks
+    AdaptiveGrain nudge_grain{ 1, 64 };
+    AdaptiveGrain move_grain{ 64 };
+    AdaptiveGrain tick_grain{ 1, 64 };
+    AdaptiveGrain shoot_grain{ 1, 64 };
+    AdaptiveGrain rocket_grain{ 8 };
+    AdaptiveGrain collision_grain{ 1, 16 };
+    AdaptiveGrain forcefield_grain{ 64, 256 };
+    AdaptiveGrain beam_grain{ 1, 64 };
+    vector<std::pair<int, int>> rocket_collisions;
+
     Terrain background_terrain;
+
+    //Re-planned routes are searched within a time budget per frame
+    PathRequests path_requests;
+    vector<PathRequests::Result> path_results;
     std::vector<vec2> forcefield_hull;
+    std::vector<vec2> forcefield_inset;     //Hull shrunk by the rocket radius, rockets outside of it hit the forcefield
+    std::vector<int> forcefield_hull_tanks; //Tank index of every hull vertex
+    std::vector<int> forcefield_order;      //Active tanks sorted on position, kept between frames so resorting is cheap
+    std::vector<vec2> forcefield_points;
+    std::vector<int> forcefield_hull_points;
 
     Font* frame_count_font;
     long long frame_count = 0;
 
     bool lock_update = false;
 
-    //Checks if a point lies on the left of an arbitrary angled line
-    bool left_of_line(vec2 line_start, vec2 line_end, vec2 point);
+    //The forcefield only has to be rebuilt when a hull tank moved or died or a tank left the hull
+    bool forcefield_outdated() const;
+    void build_forcefield();
+
+    //Asks new routes for a slice of the tanks and hands out the routes that are ready
+    void replan_routes();
+
+    //Update phases, run through update_graph
+    void build_update_graph();
+    void nudge_tanks();
+    void move_tanks();
+    void shoot();
+    void tick_smokes();
+    void update_forcefield();
+    void tick_rockets();
+    void hit_tanks_with_rockets();
+    void stop_rockets_at_forcefield();
+    void tick_particle_beams();
+    void damage_tanks_with_beams();
+    void tick_explosions();
+
+    //Makes sure there is an output for every chunk of a loop over count items, returns the number of chunks
+    int prepare_chunk_outputs(int count, int grain);
+    //Applies the events of the first chunk_count chunk outputs in chunk order
+    void apply_events(int chunk_count);
 };
 
 }; // namespace Tmpl8
\ No newline at end of file
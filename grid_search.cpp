@@ -0,0 +1,277 @@
+#include "precomp.h"
+#include "grid_search.h"
+
+namespace Tmpl8
+{
+
+static PathScratch& grid_scratch()
+{
+    static thread_local PathScratch scratch;
+    return scratch;
+}
+
+//Walks the parents back from the goal, consecutive tiles may be a straight run apart (jump points)
+static vector<int> build_route(const PathScratch& scratch, int grid_width, int goal)
+{
+    vector<int> route;
+    for (int tile = goal; tile >= 0; tile = scratch.parent[tile])
+    {
+        route.push_back(tile);
+
+        const int parent = scratch.parent[tile];
+        if (parent < 0) continue;
+
+        const int step = (parent / grid_width == tile / grid_width) ? ((parent > tile) ? 1 : -1) : ((parent > tile) ? grid_width : -grid_width);
+        for (int between = tile + step; between != parent; between += step)
+        {
+            route.push_back(between);
+        }
+    }
+    std::reverse(route.begin(), route.end());
+
+    return route;
+}
+
+vector<int> breadth_first_search(const vector<float>& costs, int grid_width, const GridRegion& region, int start, int goal, GridSearchStats* stats)
+{
+    if (!std::isfinite(costs[goal]) || !region.contains(goal % grid_width, goal / grid_width)) return {};
+
+    PathScratch& scratch = grid_scratch();
+    scratch.begin(costs.size());
+    const uint32_t search_epoch = scratch.epoch;
+
+    //The open heap doubles as queue, entries before head have been visited
+    vector<std::pair<float, int>>& queue = scratch.open_heap;
+    size_t head = 0;
+
+    scratch.parent[start] = -1;
+    scratch.seen_stamp[start] = search_epoch;
+    queue.emplace_back(0.f, start);
+
+    while (head < queue.size())
+    {
+        const int current = queue[head++].second;
+        if (stats != nullptr) stats->expansions++;
+
+        if (current == goal) return build_route(scratch, grid_width, goal);
+
+        const int x = current % grid_width;
+        const int y = current / grid_width;
+        const int neighbours[4][2] = { { x + 1, y }, { x - 1, y }, { x, y + 1 }, { x, y - 1 } };
+        for (const auto& neighbour : neighbours)
+        {
+            if (!region.contains(neighbour[0], neighbour[1])) continue;
+
+            const int next = neighbour[1] * grid_width + neighbour[0];
+            if (scratch.seen_stamp[next] == search_epoch || !std::isfinite(costs[next])) continue;
+
+            scratch.seen_stamp[next] = search_epoch;
+            scratch.parent[next] = current;
+            queue.emplace_back(0.f, next);
+        }
+    }
+
+    return {};
+}
+
+AStarSearch::AStarSearch(const vector<float>& costs, int grid_width, const GridRegion& region, int start, int goal, PathScratch& scratch)
+    : costs(&costs), grid_width(grid_width), region(region), goal(goal), scratch(&scratch)
+{
+    scratch.begin(costs.size());
+    search_epoch = scratch.epoch;
+
+    if (!std::isfinite(costs[goal]) || !region.contains(goal % grid_width, goal / grid_width))
+    {
+        finished = true;
+        return;
+    }
+
+    scratch.path_cost[start] = 0.f;
+    scratch.parent[start] = -1;
+    scratch.seen_stamp[start] = search_epoch;
+    scratch.open_heap.emplace_back(0.f, start);
+}
+
+bool AStarSearch::step(int max_expansions, GridSearchStats* stats)
+{
+    //Tiles cost at least 1, so the Manhattan distance never overestimates and the first time the goal is closed the route is optimal
+    const int goal = this->goal, grid_width = this->grid_width;
+    auto heuristic = [grid_width, goal](int tile) { return (float)(std::abs(tile % grid_width - goal % grid_width) + std::abs(tile / grid_width - goal / grid_width)); };
+
+    const vector<float>& costs = *this->costs;
+    PathScratch& scratch = *this->scratch;
+
+    for (int expansion = 0; expansion < max_expansions && !finished; expansion++)
+    {
+        if (scratch.open_heap.empty())
+        {
+            finished = true;
+            break;
+        }
+
+        std::pop_heap(scratch.open_heap.begin(), scratch.open_heap.end(), PathScratch::heap_order);
+        const int current = scratch.open_heap.back().second;
+        scratch.open_heap.pop_back();
+
+        if (scratch.closed_stamp[current] == search_epoch) continue;
+        scratch.closed_stamp[current] = search_epoch;
+        if (stats != nullptr) stats->expansions++;
+
+        if (current == goal)
+        {
+            finished = found = true;
+            break;
+        }
+
+        const int x = current % grid_width;
+        const int y = current / grid_width;
+        const int neighbours[4][2] = { { x + 1, y }, { x - 1, y }, { x, y + 1 }, { x, y - 1 } };
+        for (const auto& neighbour : neighbours)
+        {
+            if (!region.contains(neighbour[0], neighbour[1])) continue;
+
+            const int next = neighbour[1] * grid_width + neighbour[0];
+            if (scratch.closed_stamp[next] == search_epoch || !std::isfinite(costs[next])) continue;
+
+            //Moving onto a tile costs the time it takes to cross it
+            const float cost = scratch.path_cost[current] + costs[next];
+            if (scratch.seen_stamp[next] != search_epoch || cost < scratch.path_cost[next])
+            {
+                scratch.seen_stamp[next] = search_epoch;
+                scratch.path_cost[next] = cost;
+                scratch.parent[next] = current;
+
+                scratch.open_heap.emplace_back(cost + heuristic(next), next);
+                std::push_heap(scratch.open_heap.begin(), scratch.open_heap.end(), PathScratch::heap_order);
+            }
+        }
+    }
+
+    return finished;
+}
+
+vector<int> AStarSearch::route() const
+{
+    return found ? build_route(*scratch, grid_width, goal) : vector<int>();
+}
+
+vector<int> a_star_search(const vector<float>& costs, int grid_width, const GridRegion& region, int start, int goal, GridSearchStats* stats)
+{
+    AStarSearch search(costs, grid_width, region, start, goal, grid_scratch());
+    search.step(numeric_limits<int>::max(), stats);
+
+    return search.route();
+}
+
+vector<int> jump_point_search(const vector<float>& costs, int grid_width, const GridRegion& region, int start, int goal, GridSearchStats* stats)
+{
+    if (!std::isfinite(costs[goal]) || !region.contains(goal % grid_width, goal / grid_width)) return {};
+
+    PathScratch& scratch = grid_scratch();
+    scratch.begin(costs.size());
+    const uint32_t search_epoch = scratch.epoch;
+
+    const float tile_cost = costs[goal];
+    const int goal_x = goal % grid_width;
+    const int goal_y = goal / grid_width;
+
+    auto open = [&costs, &region, grid_width](int x, int y) { return region.contains(x, y) && std::isfinite(costs[y * grid_width + x]); };
+
+    //Runs until the goal, a dead end or a tile with a forced neighbour: an open tile to the side whose counterpart one step back is blocked
+    auto jump_horizontal = [&](int x, int y, int dx) {
+        while (true)
+        {
+            x += dx;
+            if (!open(x, y)) return -1;
+            if (x == goal_x && y == goal_y) return goal;
+            if ((open(x, y - 1) && !open(x - dx, y - 1)) || (open(x, y + 1) && !open(x - dx, y + 1))) return y * grid_width + x;
+        }
+    };
+
+    //Routes may only turn off a vertical run where a horizontal run from it finds a jump point
+    auto jump_vertical = [&](int x, int y, int dy) {
+        while (true)
+        {
+            y += dy;
+            if (!open(x, y)) return -1;
+            if (x == goal_x && y == goal_y) return goal;
+            if ((open(x - 1, y) && !open(x - 1, y - dy)) || (open(x + 1, y) && !open(x + 1, y - dy))) return y * grid_width + x;
+            if (jump_horizontal(x, y, 1) >= 0 || jump_horizontal(x, y, -1) >= 0) return y * grid_width + x;
+        }
+    };
+
+    auto heuristic = [goal_x, goal_y, tile_cost, grid_width](int tile) { return tile_cost * (float)(std::abs(tile % grid_width - goal_x) + std::abs(tile / grid_width - goal_y)); };
+
+    scratch.path_cost[start] = 0.f;
+    scratch.parent[start] = -1;
+    scratch.seen_stamp[start] = search_epoch;
+    scratch.open_heap.emplace_back(heuristic(start), start);
+
+    while (!scratch.open_heap.empty())
+    {
+        std::pop_heap(scratch.open_heap.begin(), scratch.open_heap.end(), PathScratch::heap_order);
+        const int current = scratch.open_heap.back().second;
+        scratch.open_heap.pop_back();
+
+        if (scratch.closed_stamp[current] == search_epoch) continue;
+        scratch.closed_stamp[current] = search_epoch;
+        if (stats != nullptr) stats->expansions++;
+
+        if (current == goal) return build_route(scratch, grid_width, goal);
+
+        const int x = current % grid_width;
+        const int y = current / grid_width;
+
+        //Coming in horizontally the route may go on or turn, coming in vertically it may go on or turn as well but never go back
+        int dx = 0, dy = 0;
+        const int parent = scratch.parent[current];
+        if (parent >= 0)
+        {
+            if (parent / grid_width == y) dx = (x > parent % grid_width) ? 1 : -1;
+            else dy = (y > parent / grid_width) ? 1 : -1;
+        }
+
+        int jump_points[4] = { -1, -1, -1, -1 };
+        if (dx >= 0) jump_points[0] = jump_horizontal(x, y, 1);
+        if (dx <= 0) jump_points[1] = jump_horizontal(x, y, -1);
+        if (dy >= 0) jump_points[2] = jump_vertical(x, y, 1);
+        if (dy <= 0) jump_points[3] = jump_vertical(x, y, -1);
+
+        for (int next : jump_points)
+        {
+            if (next < 0 || scratch.closed_stamp[next] == search_epoch) continue;
+
+            const float cost = scratch.path_cost[current] + tile_cost * (float)(std::abs(next % grid_width - x) + std::abs(next / grid_width - y));
+            if (scratch.seen_stamp[next] != search_epoch || cost < scratch.path_cost[next])
+            {
+                scratch.seen_stamp[next] = search_epoch;
+                scratch.path_cost[next] = cost;
+                scratch.parent[next] = current;
+
+                scratch.open_heap.emplace_back(cost + heuristic(next), next);
+                std::push_heap(scratch.open_heap.begin(), scratch.open_heap.end(), PathScratch::heap_order);
+            }
+        }
+    }
+
+    return {};
+}
+
+bool has_uniform_cost(const vector<float>& costs, int grid_width, const GridRegion& region)
+{
+    float uniform_cost = numeric_limits<float>::infinity();
+    for (int y = region.y; y < region.y + region.height; y++)
+    {
+        for (int x = region.x; x < region.x + region.width; x++)
+        {
+            const float cost = costs[y * grid_width + x];
+            if (!std::isfinite(cost)) continue;
+
+            if (!std::isfinite(uniform_cost)) uniform_cost = cost;
+            else if (cost != uniform_cost) return false;
+        }
+    }
+    return true;
+}
+
+} // namespace Tmpl8
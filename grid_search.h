@@ -0,0 +1,63 @@
+#pragma once
+
+namespace Tmpl8
+{
+
+//Rectangle of tiles a search is restricted to
+struct GridRegion
+{
+    int x;
+    int y;
+    int width;
+    int height;
+
+    bool contains(int tile_x, int tile_y) const { return tile_x >= x && tile_x < x + width && tile_y >= y && tile_y < y + height; };
+};
+
+//Number of tiles taken from the open list (or queue), to compare the search methods
+struct GridSearchStats
+{
+    int expansions = 0;
+};
+
+//Searches on a 4-connected grid, costs holds the cost of driving onto each tile (infinite if it can not be crossed) in rows of grid_width
+//They return the tiles of the route from start to goal (both included) and stay inside the region, the route is empty if the goal can not be reached
+//The start tile itself does not have to be open, tanks can drive off a tile they should not be on
+
+//Fewest tiles, ignores the costs of the open tiles
+vector<int> breadth_first_search(const vector<float>& costs, int grid_width, const GridRegion& region, int start, int goal, GridSearchStats* stats = nullptr);
+
+//Fastest route, open tiles have to cost at least 1 (the speed on a tile is at most 1)
+//AStarSearch can be paused after a number of expansions and continued later, the state lives in the given scratch
+class AStarSearch
+{
+  public:
+    AStarSearch(const vector<float>& costs, int grid_width, const GridRegion& region, int start, int goal, PathScratch& scratch);
+
+    //Expands at most max_expansions tiles, returns true once the search is finished
+    bool step(int max_expansions, GridSearchStats* stats = nullptr);
+    bool is_finished() const { return finished; };
+
+    //Tiles of the route once the search is finished, empty if the goal can not be reached
+    vector<int> route() const;
+
+  private:
+    const vector<float>* costs;
+    int grid_width;
+    GridRegion region;
+    int goal;
+    PathScratch* scratch;
+    uint32_t search_epoch;
+    bool finished = false;
+    bool found = false;
+};
+
+vector<int> a_star_search(const vector<float>& costs, int grid_width, const GridRegion& region, int start, int goal, GridSearchStats* stats = nullptr);
+
+//Fastest route when every open tile in the region has the same cost, see has_uniform_cost
+//Straight runs without forced neighbours are skipped, only the tiles where the route may have to turn are expanded
+vector<int> jump_point_search(const vector<float>& costs, int grid_width, const GridRegion& region, int start, int goal, GridSearchStats* stats = nullptr);
+
+bool has_uniform_cost(const vector<float>& costs, int grid_width, const GridRegion& region);
+
+} // namespace Tmpl8
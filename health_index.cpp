@@ -0,0 +1,89 @@
+#include "precomp.h"
+#include "health_index.h"
+
+namespace Tmpl8
+{
+
+void HealthIndex::add(int tank, int team, int health)
+{
+    if (tank >= (int)next.size())
+    {
+        next.resize(tank + 1, -1);
+        previous.resize(tank + 1, -1);
+        tank_team.resize(tank + 1, 0);
+        tank_health.resize(tank + 1, -1);
+    }
+
+    if (tank_health[tank] >= 0) unlink(tank);
+
+    tank_team[tank] = team;
+    tank_health[tank] = std::max(health, 0);
+    resize_buckets(std::max(teams, team + 1), std::max(buckets, tank_health[tank] + 1));
+
+    link(tank);
+    changes++;
+}
+
+void HealthIndex::set_health(int tank, int health)
+{
+    if (health <= 0)
+    {
+        remove(tank);
+        return;
+    }
+
+    if (tank_health[tank] < 0 || tank_health[tank] == health) return;
+
+    unlink(tank);
+    tank_health[tank] = health;
+    resize_buckets(teams, std::max(buckets, health + 1));
+    link(tank);
+    changes++;
+}
+
+void HealthIndex::remove(int tank)
+{
+    if (tank >= (int)tank_health.size() || tank_health[tank] < 0) return;
+
+    unlink(tank);
+    tank_health[tank] = -1;
+    changes++;
+}
+
+void HealthIndex::link(int tank)
+{
+    int& head = heads[(size_t)tank_team[tank] * buckets + tank_health[tank]];
+
+    previous[tank] = -1;
+    next[tank] = head;
+    if (head >= 0) previous[head] = tank;
+    head = tank;
+}
+
+void HealthIndex::unlink(int tank)
+{
+    if (previous[tank] >= 0)
+        next[previous[tank]] = next[tank];
+    else
+        heads[(size_t)tank_team[tank] * buckets + tank_health[tank]] = next[tank];
+
+    if (next[tank] >= 0) previous[next[tank]] = previous[tank];
+}
+
+//Only happens while tanks are added, health only goes down afterwards
+void HealthIndex::resize_buckets(int new_teams, int new_buckets)
+{
+    if (new_teams == teams && new_buckets == buckets) return;
+
+    vector<int> resized((size_t)new_teams * new_buckets, -1);
+    for (int team = 0; team < teams; team++)
+    {
+        std::copy(heads.begin() + (size_t)team * buckets, heads.begin() + (size_t)(team + 1) * buckets, resized.begin() + (size_t)team * new_buckets);
+    }
+
+    heads.swap(resized);
+    teams = new_teams;
+    buckets = new_buckets;
+}
+
+} // namespace Tmpl8
@@ -0,0 +1,51 @@
+#pragma once
+
+namespace Tmpl8
+{
+
+//Active tanks bucketed on health per team, every bucket is an intrusive linked list so changing the health of a tank is O(1)
+//Walking the buckets from low to high gives the tanks in health order without sorting
+class HealthIndex
+{
+  public:
+    void add(int tank, int team, int health);
+    void set_health(int tank, int health);
+    void remove(int tank);
+
+    //Calls function(tank, health) for at most count tanks of the team, lowest health first
+    template <class F>
+    void for_lowest(int team, int count, const F& function) const
+    {
+        if (team >= teams) return;
+
+        const int* team_heads = &heads[(size_t)team * buckets];
+        for (int health = 0; health < buckets && count > 0; health++)
+        {
+            for (int tank = team_heads[health]; tank >= 0 && count > 0; tank = next[tank], count--)
+            {
+                function(tank, health);
+            }
+        }
+    }
+
+    //Changes every time a tank is added, removed or changes health
+    uint32_t version() const { return changes; }
+
+  private:
+    void link(int tank);
+    void unlink(int tank);
+    void resize_buckets(int new_teams, int new_buckets);
+
+    int teams = 0;
+    int buckets = 0;
+    vector<int> heads; //First tank per (team, health) bucket, -1 if empty
+
+    vector<int> next;
+    vector<int> previous;
+    vector<int> tank_team;
+    vector<int> tank_health; //-1 when the tank is not in the index
+
+    uint32_t changes = 0;
+};
+
+} // namespace Tmpl8
@@ -0,0 +1,120 @@
+#include "precomp.h"
+#include "kd_tree.h"
+
+namespace Tmpl8
+{
+
+void KdTree::build(const vector<Tank>& tanks, const vector<int>& team_tanks)
+{
+    points.clear();
+    nodes.clear();
+
+    for (int i : team_tanks)
+    {
+        //Tanks with an invalid position never win a distance comparison, leave them out
+        const vec2 position = tanks[i].get_position();
+        if (std::isfinite(position.x) && std::isfinite(position.y))
+        {
+            points.push_back({ position, i });
+        }
+    }
+
+    if (!points.empty())
+    {
+        build_node(0, (int)points.size());
+    }
+}
+
+//Splits the range at the median of its widest axis, returns the index of the created node
+int KdTree::build_node(int begin, int end)
+{
+    const int node_index = (int)nodes.size();
+    nodes.push_back({ 0.f, -1, begin, end, -1, -1 });
+
+    if (end - begin <= leaf_size)
+    {
+        return node_index;
+    }
+
+    vec2 min_pos = points[begin].position;
+    vec2 max_pos = points[begin].position;
+    for (int i = begin + 1; i < end; i++)
+    {
+        min_pos.x = std::min(min_pos.x, points[i].position.x);
+        min_pos.y = std::min(min_pos.y, points[i].position.y);
+        max_pos.x = std::max(max_pos.x, points[i].position.x);
+        max_pos.y = std::max(max_pos.y, points[i].position.y);
+    }
+
+    const int axis = ((max_pos.x - min_pos.x) >= (max_pos.y - min_pos.y)) ? 0 : 1;
+    const int mid = begin + (end - begin) / 2;
+
+    //Everything left of mid ends up <= the split value, everything right of it >= the split value
+    std::nth_element(points.begin() + begin, points.begin() + mid, points.begin() + end, [axis](const Point& a, const Point& b) { return a.position.cell[axis] < b.position.cell[axis]; });
+
+    const float split = points[mid].position.cell[axis];
+    const int left = build_node(begin, mid);
+    const int right = build_node(mid, end);
+
+    Node& node = nodes[node_index];
+    node.split = split;
+    node.axis = axis;
+    node.left = left;
+    node.right = right;
+
+    return node_index;
+}
+
+void KdTree::find_nearest(const vec2& position, int& closest_index, float& closest_distance) const
+{
+    if (nodes.empty()) return;
+
+    //Explicit stack of nodes to visit, together with a lower bound on the distance to anything below them
+    struct Entry
+    {
+        int node;
+        float min_distance;
+    };
+    Entry stack[max_depth * 2];
+    int stack_size = 0;
+    stack[stack_size++] = { 0, 0.f };
+
+    while (stack_size > 0)
+    {
+        const Entry entry = stack[--stack_size];
+
+        //Strictly greater, nodes at exactly the current distance may still hold a tank with a lower index
+        if (entry.min_distance > closest_distance) continue;
+
+        const Node& node = nodes[entry.node];
+
+        if (node.axis < 0)
+        {
+            for (int i = node.begin; i < node.end; i++)
+            {
+                const Point& point = points[i];
+                float sqr_dist = fabsf((point.position - position).sqr_length());
+
+                if (sqr_dist < closest_distance || (sqr_dist == closest_distance && point.tank_index < closest_index))
+                {
+                    closest_distance = sqr_dist;
+                    closest_index = point.tank_index;
+                }
+            }
+            continue;
+        }
+
+        //Any point on the far side of the split is at least as far away as the split plane itself
+        const float plane_distance = position.cell[node.axis] - node.split;
+        const float far_distance = std::max(entry.min_distance, plane_distance * plane_distance);
+
+        const int near_node = (plane_distance < 0.f) ? node.left : node.right;
+        const int far_node = (plane_distance < 0.f) ? node.right : node.left;
+
+        //Push the far side first so the near side is searched first and tightens the bound
+        stack[stack_size++] = { far_node, far_distance };
+        stack[stack_size++] = { near_node, entry.min_distance };
+    }
+}
+
+} // namespace Tmpl8
@@ -0,0 +1,43 @@
+#pragma once
+
+namespace Tmpl8
+{
+class Tank; //forward declare
+
+//2D k-d tree over tank positions, answers exact nearest neighbour queries
+//Built from scratch every time it is used, leaves hold a few tanks each to keep the tree shallow
+class KdTree
+{
+  public:
+    //Builds the tree from all active tanks with the given allignment
+    void build(const vector<Tank>& tanks, const vector<int>& team_tanks);
+
+    //Updates closest_index/closest_distance if a tank in this tree is closer to the given position
+    //Uses the same squared distance as a linear scan, on equal distance the lowest tank index wins
+    void find_nearest(const vec2& position, int& closest_index, float& closest_distance) const;
+
+  private:
+    struct Point
+    {
+        vec2 position;
+        int tank_index;
+    };
+
+    struct Node
+    {
+        float split;
+        int axis; //-1 for leafs
+        int begin, end; //Range of points below this node
+        int left, right;
+    };
+
+    int build_node(int begin, int end);
+
+    static constexpr int leaf_size = 8;
+    static constexpr int max_depth = 64;
+
+    vector<Point> points;
+    vector<Node> nodes;
+};
+
+} // namespace Tmpl8
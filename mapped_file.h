@@ -0,0 +1,35 @@
+#pragma once
+
+namespace Tmpl8
+{
+//Read only memory mapping of a whole file, the mapping is released when the object is destroyed
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    //Returns false (and stays closed) if the file does not exist or can not be mapped
+    bool open(const std::filesystem::path& path);
+    void close();
+
+    bool is_open() const { return data != nullptr; };
+    const uint8_t* get_data() const { return data; };
+    size_t get_size() const { return size; };
+
+  private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int file = -1;
+#endif
+};
+
+} // namespace Tmpl8
@@ -0,0 +1,97 @@
+#pragma once
+
+namespace Tmpl8
+{
+
+//Pool of objects with O(1) spawn and retire and a dense range for iteration
+//Storage only grows when the pool is full, reserve up front so the pool does not allocate during the game
+//Retiring moves the last object into the hole, so the iteration order is not stable and objects are only reached by iterating
+template <class T>
+class ObjectPool
+{
+  public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool()
+    {
+        for (int i = 0; i < count; i++)
+        {
+            objects[i].~T();
+        }
+        ::operator delete(objects);
+    }
+
+    void reserve(int new_capacity)
+    {
+        if (new_capacity <= capacity) return;
+
+        T* resized = static_cast<T*>(::operator new(sizeof(T) * new_capacity));
+        for (int i = 0; i < count; i++)
+        {
+            new (&resized[i]) T(std::move(objects[i]));
+            objects[i].~T();
+        }
+        ::operator delete(objects);
+        objects = resized;
+
+        capacity = new_capacity;
+        allocation_count++;
+    }
+
+    template <class... Args>
+    T& spawn(Args&&... args)
+    {
+        if (count == capacity)
+        {
+            reserve(std::max(capacity * 2, 64));
+        }
+
+        return *new (&objects[count++]) T(std::forward<Args>(args)...);
+    }
+
+    //Retires every object for which predicate returns true
+    template <class P>
+    void retire_if(const P& predicate)
+    {
+        for (int i = 0; i < count;)
+        {
+            if (predicate(objects[i]))
+                retire_at(i); //The last object moved to i, check it next
+            else
+                i++;
+        }
+    }
+
+    T* begin() { return objects; }
+    T* end() { return objects + count; }
+    const T* begin() const { return objects; }
+    const T* end() const { return objects + count; }
+
+    int size() const { return count; }
+
+    //Number of times the storage was (re)allocated
+    int allocations() const { return allocation_count; }
+
+  private:
+    void retire_at(int index)
+    {
+        const int last = count - 1;
+
+        objects[index].~T();
+        if (index != last)
+        {
+            new (&objects[index]) T(std::move(objects[last]));
+            objects[last].~T();
+        }
+        count--;
+    }
+
+    T* objects = nullptr;
+    int count = 0;
+    int capacity = 0;
+    int allocation_count = 0;
+};
+
+} // namespace Tmpl8
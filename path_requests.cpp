@@ -0,0 +1,49 @@
+#include "precomp.h"
+#include "path_requests.h"
+
+namespace Tmpl8
+{
+void PathRequests::request(int tank, int start, int goal)
+{
+    if (tank >= (int)waiting.size()) waiting.resize(tank + 1, false);
+    if (waiting[tank] || start < 0 || goal < 0) return;
+
+    waiting[tank] = true;
+    queue.push_back({ tank, start, goal });
+}
+
+void PathRequests::process(const Terrain& terrain, float budget_us, vector<Result>& results)
+{
+    const GridRegion region{ 0, 0, terrain.get_width(), terrain.get_height() };
+
+    timer budget_timer;
+    while (budget_timer.elapsed() * 1000.f < budget_us)
+    {
+        if (!active_search)
+        {
+            if (queue.empty()) return;
+
+            active_request = queue.front();
+            queue.pop_front();
+
+            //Jump point search can not be paused, but on uniform terrain it only expands the tiles where routes turn, so it runs in one go
+            if (terrain.has_uniform_cost())
+            {
+                waiting[active_request.tank] = false;
+                results.push_back({ active_request.tank, terrain.get_route(active_request.start, active_request.goal) });
+                continue;
+            }
+
+            active_search = std::make_unique<AStarSearch>(terrain.get_costs(), region.width, region, active_request.start, active_request.goal, scratch);
+        }
+
+        if (active_search->step(expansions_per_check))
+        {
+            waiting[active_request.tank] = false;
+            results.push_back({ active_request.tank, active_search->route() });
+            active_search.reset();
+        }
+    }
+}
+
+} // namespace Tmpl8
@@ -0,0 +1,47 @@
+#pragma once
+
+namespace Tmpl8
+{
+//Queue of route requests that is worked on for a limited time every frame, so re-planning never causes a frame spike
+//An A* search that does not fit in the budget of a frame is continued in the next frame
+//On terrain where all open tiles cost the same the routes are found with jump point search instead, one request at a time
+class PathRequests
+{
+  public:
+    struct Result
+    {
+        int tank;
+
+        //Tiles from the start to the goal, empty if the goal can not be reached
+        vector<int> route;
+    };
+
+    //Queues a route between two tiles, a tank that is still waiting for a route is not queued again
+    void request(int tank, int start, int goal);
+
+    //Works on the requests until budget_us microseconds have passed, finished routes are added to results
+    void process(const Terrain& terrain, float budget_us, vector<Result>& results);
+
+    size_t pending() const { return queue.size() + (active_search ? 1 : 0); };
+
+  private:
+    struct Request
+    {
+        int tank;
+        int start;
+        int goal;
+    };
+
+    //Expansions between two checks of the budget
+    static constexpr int expansions_per_check = 64;
+
+    std::deque<Request> queue;
+    vector<bool> waiting;
+
+    //The search in progress keeps its state in the scratch between frames
+    Request active_request;
+    std::unique_ptr<AStarSearch> active_search;
+    PathScratch scratch;
+};
+
+} // namespace Tmpl8
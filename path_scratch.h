@@ -0,0 +1,43 @@
+#pragma once
+
+namespace Tmpl8
+{
+//Scratch data of a route search, entries are only valid when their stamp equals the epoch so nothing has to be reset between searches
+//Every thread has its own, so searches can run at the same time
+struct PathScratch
+{
+    std::vector<float> path_cost;
+    std::vector<int> parent;
+    std::vector<uint32_t> seen_stamp;
+    std::vector<uint32_t> closed_stamp;
+    std::vector<std::pair<float, int>> open_heap;
+    uint32_t epoch = 0;
+
+    //Start a new search over node_count nodes
+    void begin(size_t node_count)
+    {
+        if (path_cost.size() != node_count)
+        {
+            path_cost.resize(node_count);
+            parent.resize(node_count);
+            seen_stamp.assign(node_count, 0);
+            closed_stamp.assign(node_count, 0);
+            open_heap.reserve(node_count);
+            epoch = 0;
+        }
+
+        //New epoch instead of clearing the scratch data, only on wrap around the stamps have to be cleared
+        if (++epoch == 0)
+        {
+            std::fill(seen_stamp.begin(), seen_stamp.end(), 0);
+            std::fill(closed_stamp.begin(), closed_stamp.end(), 0);
+            epoch = 1;
+        }
+        open_heap.clear();
+    }
+
+    //Binary min heap on the first element, entries that were improved later are skipped when popped
+    static bool heap_order(const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; }
+};
+
+} // namespace Tmpl8
@@ -51,8 +51,12 @@
 #include <string>
 #include <vector>
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
+#include <functional>
 #include <queue>
+#include <unordered_map>
 #include <future>
 #include <mutex>
 #include <thread>
@@ -82,13 +86,31 @@ using namespace std;
 using namespace Tmpl8;
 
 #include "thread_pool.h"
-
+#include "mapped_file.h"
+#include "object_pool.h"
+#include "task_graph.h"
+#include "dirty_regions.h"
+
+#include "health_index.h"
+#include "path_scratch.h"
+#include "grid_search.h"
+#include "cluster_graph.h"
+#include "tank_system.h"
 #include "tank.h"
+#include "tank_grid.h"
+#include "kd_tree.h"
+#include "convex_hull.h"
 #include "terrain.h"
+#ifdef BAKED_TERRAIN
+#include "baked_terrain.h"
+#endif
+#include "path_requests.h"
 #include "rocket.h"
+#include "rocket_system.h"
 #include "smoke.h"
 #include "explosion.h"
 #include "particle_beam.h"
+#include "event_buffer.h"
 
 #include "game.h"
 
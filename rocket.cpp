@@ -13,12 +13,6 @@ Rocket::~Rocket()
 {
 }
 
-void Rocket::tick()
-{
-    position += speed;
-    if (++current_frame > 8) current_frame = 0;
-}
-
 //Draw the sprite with the facing based on this rockets movement direction
 void Rocket::draw(Surface* screen)
 {
@@ -26,20 +20,4 @@ void Rocket::draw(Surface* screen)
     rocket_sprite->draw(screen, (int)position.x - 12 + HEALTHBAR_OFFSET, (int)position.y - 12);
 }
 
-//Does the given circle collide with this rockets collision circle?
-bool Rocket::intersects(vec2 position_other, float radius_other) const
-{
-    //Note: Uses squared lengths to remove expensive square roots
-    float distance_sqr = (position_other - position).sqr_length();
-
-    if (distance_sqr <= ((collision_radius + radius_other) * (collision_radius + radius_other)))
-    {
-        return true;
-    }
-    else
-    {
-        return false;
-    }
-}
-
 } // namespace Tmpl8
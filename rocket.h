@@ -3,17 +3,16 @@
 namespace Tmpl8
 {
 
+//A single rocket, used to spawn and draw rockets
+//Live rockets are stored and updated in the RocketSystem
 class Rocket
 {
   public:
     Rocket(vec2 position, vec2 direction, float collision_radius, allignments allignment, Sprite* rocket_sprite);
     ~Rocket();
 
-    void tick();
     void draw(Surface* screen);
 
-    bool intersects(vec2 position_other, float radius_other) const;
-
     vec2 position;
     vec2 speed;
 
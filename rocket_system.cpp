@@ -0,0 +1,218 @@
+#include "precomp.h"
+#include "rocket_system.h"
+
+namespace Tmpl8
+{
+
+RocketSystem::~RocketSystem()
+{
+    for (float* data : { position_x, position_y, speed_x, speed_y, collision_radius })
+    {
+        if (data) FREE64(data);
+    }
+    if (allignment) FREE64(allignment);
+}
+
+template <typename T>
+static void resize_aligned(T*& data, int count, int new_capacity)
+{
+    T* resized = (T*)MALLOC64(new_capacity * sizeof(T));
+    memset(resized, 0, new_capacity * sizeof(T));
+
+    if (data)
+    {
+        memcpy(resized, data, count * sizeof(T));
+        FREE64(data);
+    }
+    data = resized;
+}
+
+void RocketSystem::reserve(int new_capacity)
+{
+    //Arrays are padded to whole AVX registers, the padding lanes are never active
+    new_capacity = (new_capacity + 7) & ~7;
+    if (new_capacity <= capacity) return;
+
+    resize_aligned(position_x, count, new_capacity);
+    resize_aligned(position_y, count, new_capacity);
+    resize_aligned(speed_x, count, new_capacity);
+    resize_aligned(speed_y, count, new_capacity);
+    resize_aligned(collision_radius, count, new_capacity);
+    resize_aligned(allignment, count, new_capacity);
+
+    capacity = new_capacity;
+    active_bits.resize((capacity + 63) / 64, 0);
+    current_frame.resize(capacity);
+    rocket_sprite.resize(capacity);
+    allocation_count++;
+}
+
+void RocketSystem::add(const Rocket& rocket)
+{
+    if (count == capacity)
+    {
+        reserve(std::max(capacity * 2, 64));
+    }
+
+    const int index = count++;
+
+    position_x[index] = rocket.position.x;
+    position_y[index] = rocket.position.y;
+    speed_x[index] = rocket.speed.x;
+    speed_y[index] = rocket.speed.y;
+    collision_radius[index] = rocket.collision_radius;
+    allignment[index] = rocket.allignment;
+    current_frame[index] = rocket.current_frame;
+    rocket_sprite[index] = rocket.rocket_sprite;
+
+    if (rocket.active)
+    {
+        active_bits[index >> 6] |= uint64_t(1) << (index & 63);
+    }
+}
+
+Rocket RocketSystem::get(int index) const
+{
+    Rocket rocket(get_position(index), vec2(speed_x[index], speed_y[index]), collision_radius[index], (allignments)allignment[index], rocket_sprite[index]);
+    rocket.current_frame = current_frame[index];
+    rocket.active = is_active(index);
+    return rocket;
+}
+
+void RocketSystem::tick(int begin, int end)
+{
+    int i = begin;
+
+#ifdef __AVX2__
+    for (; i + 8 <= end; i += 8)
+    {
+        _mm256_store_ps(position_x + i, _mm256_add_ps(_mm256_load_ps(position_x + i), _mm256_load_ps(speed_x + i)));
+        _mm256_store_ps(position_y + i, _mm256_add_ps(_mm256_load_ps(position_y + i), _mm256_load_ps(speed_y + i)));
+    }
+#endif
+
+    for (; i < end; i++)
+    {
+        position_x[i] += speed_x[i];
+        position_y[i] += speed_y[i];
+    }
+
+    for (i = begin; i < end; i++)
+    {
+        if (++current_frame[i] > 8) current_frame[i] = 0;
+    }
+}
+
+uint32_t RocketSystem::intersects(int begin, vec2 position, float radius, allignments team) const
+{
+    const uint32_t active = (uint32_t)(active_bits[begin >> 6] >> (begin & 63)) & 0xff;
+    if (active == 0) return 0;
+
+#ifdef __AVX2__
+    //Note: Uses squared lengths to remove expensive square roots
+    const __m256 delta_x = _mm256_sub_ps(_mm256_set1_ps(position.x), _mm256_load_ps(position_x + begin));
+    const __m256 delta_y = _mm256_sub_ps(_mm256_set1_ps(position.y), _mm256_load_ps(position_y + begin));
+    const __m256 distance_sqr = _mm256_add_ps(_mm256_mul_ps(delta_x, delta_x), _mm256_mul_ps(delta_y, delta_y));
+
+    const __m256 radius_sum = _mm256_add_ps(_mm256_load_ps(collision_radius + begin), _mm256_set1_ps(radius));
+    const __m256 overlap = _mm256_cmp_ps(distance_sqr, _mm256_mul_ps(radius_sum, radius_sum), _CMP_LE_OQ);
+
+    //Rockets never hit tanks of their own team
+    const __m256i same_team = _mm256_cmpeq_epi32(_mm256_load_si256((const __m256i*)(allignment + begin)), _mm256_set1_epi32(team));
+    const __m256 hits = _mm256_andnot_ps(_mm256_castsi256_ps(same_team), overlap);
+
+    return (uint32_t)_mm256_movemask_ps(hits) & active;
+#else
+    uint32_t hits = 0;
+    for (int lane = 0; lane < 8; lane++)
+    {
+        const int i = begin + lane;
+        const float delta_x = position.x - position_x[i];
+        const float delta_y = position.y - position_y[i];
+        const float radius_sum = collision_radius[i] + radius;
+
+        if (allignment[i] != team && (delta_x * delta_x + delta_y * delta_y) <= radius_sum * radius_sum)
+        {
+            hits |= 1u << lane;
+        }
+    }
+    return hits & active;
+#endif
+}
+
+void RocketSystem::find_collisions(const vector<Tank>& tanks, const int* tank_indices, int tank_count, vector<std::pair<int, int>>& collisions) const
+{
+    //Test every given tank against all rockets, 8 rockets at a time
+    for (int t = 0; t < tank_count; t++)
+    {
+        const int tank_index = tank_indices[t];
+        const Tank& tank = tanks[tank_index];
+
+        const vec2 position = tank.get_position();
+
+        for (int begin = 0; begin < count; begin += 8)
+        {
+            uint32_t hits = intersects(begin, position, tank.get_collision_radius(), tank.allignment);
+
+            for (int lane = 0; hits != 0; lane++, hits >>= 1)
+            {
+                if (hits & 1)
+                {
+                    collisions.emplace_back(begin + lane, tank_index);
+                }
+            }
+        }
+    }
+}
+
+void RocketSystem::group_collisions(const vector<std::pair<int, int>>& collisions)
+{
+    //Counting sort on rocket index, this keeps the tanks of each rocket in the order they were given
+    collision_start.assign(count + 1, 0);
+    for (const auto& pair : collisions)
+    {
+        collision_start[pair.first + 1]++;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        collision_start[i + 1] += collision_start[i];
+    }
+
+    collision_tanks.resize(collisions.size());
+    collision_fill.assign(collision_start.begin(), collision_start.end() - 1);
+    for (const auto& pair : collisions)
+    {
+        collision_tanks[collision_fill[pair.first]++] = pair.second;
+    }
+}
+
+void RocketSystem::remove_inactive()
+{
+    int alive = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!is_active(i)) continue;
+
+        position_x[alive] = position_x[i];
+        position_y[alive] = position_y[i];
+        speed_x[alive] = speed_x[i];
+        speed_y[alive] = speed_y[i];
+        collision_radius[alive] = collision_radius[i];
+        allignment[alive] = allignment[i];
+        current_frame[alive] = current_frame[i];
+        rocket_sprite[alive] = rocket_sprite[i];
+        alive++;
+    }
+
+    count = alive;
+
+    //All remaining rockets are active
+    std::fill(active_bits.begin(), active_bits.end(), 0);
+    for (int i = 0; i < count; i++)
+    {
+        active_bits[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+}
+
+} // namespace Tmpl8
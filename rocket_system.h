@@ -0,0 +1,70 @@
+#pragma once
+
+namespace Tmpl8
+{
+class Tank; //forward declare
+
+//All live rockets stored as a structure of arrays, so 8 rockets can be moved or hit tested at once with AVX2
+//Rockets are kept in spawn order, remove_inactive compacts the arrays while keeping that order
+class RocketSystem
+{
+  public:
+    RocketSystem() = default;
+    ~RocketSystem();
+
+    RocketSystem(const RocketSystem&) = delete;
+    RocketSystem& operator=(const RocketSystem&) = delete;
+
+    void reserve(int new_capacity);
+
+    void add(const Rocket& rocket);
+    Rocket get(int index) const;
+
+    int size() const { return count; }
+
+    //Number of times the arrays were (re)allocated
+    int allocations() const { return allocation_count; }
+
+    vec2 get_position(int index) const { return vec2(position_x[index], position_y[index]); }
+    bool is_active(int index) const { return (active_bits[index >> 6] >> (index & 63)) & 1; }
+    void deactivate(int index) { active_bits[index >> 6] &= ~(uint64_t(1) << (index & 63)); }
+
+    //Move the rockets in [begin, end) and advance their animation, begin must be a multiple of 8
+    void tick(int begin, int end);
+
+    //Appends a (rocket, tank) pair for every active rocket overlapping an enemy tank in tank_indices[0] up to tank_indices[tank_count]
+    void find_collisions(const vector<Tank>& tanks, const int* tank_indices, int tank_count, vector<std::pair<int, int>>& collisions) const;
+
+    //Groups collision pairs per rocket, pairs must be ordered on tank index
+    //The tanks hit by rocket i are collision_tanks[collision_start[i]] up to collision_tanks[collision_start[i + 1]], in index order
+    void group_collisions(const vector<std::pair<int, int>>& collisions);
+
+    //Removes inactive rockets, the remaining rockets keep their order
+    void remove_inactive();
+
+    vector<int> collision_start;
+    vector<int> collision_tanks;
+
+  private:
+    //Bit per rocket in [begin, begin + 8) that is active, not in the given team and overlaps the given circle
+    uint32_t intersects(int begin, vec2 position, float radius, allignments allignment) const;
+
+    int count = 0;
+    int capacity = 0;
+    int allocation_count = 0;
+
+    float* position_x = nullptr;
+    float* position_y = nullptr;
+    float* speed_x = nullptr;
+    float* speed_y = nullptr;
+    float* collision_radius = nullptr;
+    int* allignment = nullptr;
+
+    vector<uint64_t> active_bits;
+    vector<int> current_frame;
+    vector<Sprite*> rocket_sprite;
+
+    vector<int> collision_fill;
+};
+
+} // namespace Tmpl8
@@ -80,6 +80,12 @@ void Surface::clear(Pixel a_Color)
 {
     int s = m_Width * m_Height;
     for (int i = 0; i < s; i++) m_Buffer[i] = a_Color;
+    if (m_DirtyRegions) m_DirtyRegions->invalidate();
+}
+
+void Surface::mark_drawn(int x1, int y1, int x2, int y2)
+{
+    if (m_DirtyRegions) m_DirtyRegions->add(x1, y1, x2, y2);
 }
 
 void Surface::centre(const char* a_String, int y1, Pixel color)
@@ -95,6 +101,7 @@ void Surface::print(const char* a_String, int x1, int y1, Pixel color)
         init_charset();
         fontInitialized = true;
     }
+    mark_drawn(x1, y1, x1 + (int)strlen(a_String) * 6, y1 + 6);
     Pixel* t = m_Buffer + x1 + y1 * m_Pitch;
     for (int i = 0; i < (int)(strlen(a_String)); i++, t += 6)
     {
@@ -174,6 +181,7 @@ void Surface::line(float x1, float y1, float x2, float y2, Pixel c)
         }
     }
     if (!accept) return;
+    mark_drawn((int)std::min(x1, x2), (int)std::min(y1, y2), (int)std::max(x1, x2) + 1, (int)std::max(y1, y2) + 1);
     float b = x2 - x1;
     float h = y2 - y1;
     float l = fabsf(b);
@@ -196,7 +204,10 @@ void Surface::line(vec2 start, vec2 end, Pixel color)
 void Surface::plot(int x, int y, Pixel c)
 {
     if ((x >= 0) && (y >= 0) && (x < m_Width) && (y < m_Height))
+    {
         m_Buffer[x + y * m_Pitch] = c;
+        mark_drawn(x, y, x + 1, y + 1);
+    }
 }
 
 void Surface::box(int x1, int y1, int x2, int y2, Pixel c)
@@ -209,6 +220,7 @@ void Surface::box(int x1, int y1, int x2, int y2, Pixel c)
 
 void Surface::bar(int x1, int y1, int x2, int y2, Pixel c)
 {
+    mark_drawn(x1, y1, x2 + 1, y2 + 1);
     Pixel* a = x1 + y1 * m_Pitch + m_Buffer;
     for (int y = y1; y <= y2; y++)
     {
@@ -403,6 +415,7 @@ void Sprite::draw(Surface* a_Target, int a_X, int a_Y)
     const int dpitch = a_Target->get_pitch();
     if ((x2 > x1) && (y2 > y1))
     {
+        a_Target->mark_drawn(x1, y1, x2, y2);
         unsigned int addr = y1 * dpitch + x1;
         const int width = x2 - x1;
         const int height = y2 - y1;
@@ -468,6 +481,7 @@ void Sprite::draw_scaled(int a_X, int a_Y, int a_Width, int a_Height, Surface* a
     }
     if (y2 > a_Target->get_height()) y_end = a_Height - (y2 - a_Target->get_height());
 
+    a_Target->mark_drawn(a_X + x_start, a_Y + y_start, a_X + x_end, a_Y + y_end);
     for (int x = x_start; x < x_end; x++)
     {
         for (int y = y_start; y < y_end; y++)
@@ -576,6 +590,7 @@ void Font::print(Surface* a_Target, const char* a_Text, int a_X, int a_Y, bool c
     unsigned int i, cx;
     int x, y;
     if (((a_Y + m_Height) < m_CY1) || (a_Y > m_CY2)) return;
+    a_Target->mark_drawn(a_X, a_Y, a_X + width(a_Text), a_Y + m_Height);
     for (cx = 0, i = 0; i < strlen(a_Text); i++)
     {
         if (a_Text[i] == ' ')
@@ -12,6 +12,8 @@ namespace Tmpl8
 
 typedef unsigned int Pixel; // unsigned int is assumed to be 32-bit, which seems a safe assumption.
 
+class DirtyRegions;
+
 inline Pixel add_blend(Pixel a_Color1, Pixel a_Color2)
 {
     const unsigned int r = (a_Color1 & REDMASK) + (a_Color2 & REDMASK);
@@ -79,6 +81,9 @@ class Surface
     void box(int x1, int y1, int x2, int y2, Pixel color);
     void bar(int x1, int y1, int x2, int y2, Pixel color);
     void resize(Surface* a_Orig);
+    // Drawing operations report the area they change to the dirty regions, if set (copies are not reported)
+    void set_dirty_regions(DirtyRegions* a_Regions) { m_DirtyRegions = a_Regions; }
+    void mark_drawn(int x1, int y1, int x2, int y2);
 
   private:
     // Attributes
@@ -86,6 +91,7 @@ class Surface
     int m_Width, m_Height;
     int m_Pitch;
     int m_Flags;
+    DirtyRegions* m_DirtyRegions = nullptr;
     // Static attributes for the builtin font
     static char s_Font[51][5][6];
     static bool fontInitialized;
@@ -5,6 +5,7 @@
 namespace Tmpl8
 {
 Tank::Tank(
+    TankSystem& system,
     float pos_x,
     float pos_y,
     allignments allignment,
@@ -15,17 +16,15 @@ Tank::Tank(
     float collision_radius,
     int health,
     float max_speed)
-    : position(pos_x, pos_y),
-      allignment(allignment),
-      target(tar_x, tar_y),
+    : system(&system),
+      id(system.add(vec2(pos_x, pos_y), vec2(tar_x, tar_y), max_speed, allignment, health)),
+      destination(tar_x, tar_y),
+      flow_field(nullptr),
       health(health),
       collision_radius(collision_radius),
-      max_speed(max_speed),
-      force(0, 0),
       reload_time(1),
       reloaded(false),
-      speed(0),
-      active(true),
+      allignment(allignment),
       current_frame(0),
       tank_sprite(tank_sprite),
       smoke_sprite(smoke_sprite)
@@ -38,52 +37,69 @@ Tank::~Tank()
 
 void Tank::tick(Terrain& terrain)
 {
-    vec2 direction = vec2(0, 0);
-
-    if (target != position)
-    {
-        direction = (target - position).normalized();
-    }
-
-    //Update using accumulated force
-    speed = direction + force;
-    position += speed * max_speed * 0.5f;
-
     //Update reload time
     if (--reload_time <= 0.0f)
     {
         reloaded = true;
     }
 
-    force = vec2(0.f, 0.f);
-
     if (++current_frame > 8) current_frame = 0;
 
-    //Target reached?
-    if (current_route.size() > 0)
+    //Target reached? Continue with the next tile of the flow field or route
+    if (flow_field != nullptr || !hierarchical_route.empty())
     {
+        const vec2 position = get_position();
+        const vec2 target = get_target();
+
         if (std::abs(position.x - target.x) < 8.f && std::abs(position.y - target.y) < 8.f)
         {
-            target = current_route.at(0);
-            current_route.erase(current_route.begin());
+            set_target((flow_field != nullptr) ? terrain.next_waypoint(*flow_field, target) : terrain.next_waypoint(hierarchical_route, target));
         }
     }
 }
 
-void Tank::set_route(const std::vector<vec2>& route)
+void Tank::follow(const FlowField* flow_field, const Terrain& terrain)
 {
-    if (route.size() > 0)
+    hierarchical_route = HierarchicalRoute();
+
+    const vec2 position = get_position();
+    if (flow_field != nullptr && terrain.can_reach(*flow_field, position))
     {
-        current_route = route;
-        target = current_route.at(0);
-        current_route.erase(current_route.begin());
+        //Start at the corner of the current tile, like the first point of a route
+        this->flow_field = flow_field;
+        set_target(terrain.tile_corner(terrain.tile_index(position)));
     }
     else
     {
-        target = position;
+        this->flow_field = nullptr;
+        set_target(position);
     }
 }
 
+void Tank::follow(HierarchicalRoute route, const Terrain& terrain)
+{
+    flow_field = nullptr;
+    hierarchical_route = std::move(route);
+
+    //Start at the corner of the current tile, like with flow fields
+    set_target(hierarchical_route.empty() ? get_position() : terrain.tile_corner(hierarchical_route.abstract_path.front()));
+}
+
+void Tank::replace_route(vector<int> tiles, const Terrain& terrain)
+{
+    if (tiles.empty()) return;
+
+    //Go on from the waypoint the tank is driving to if it is on the new route, so it never turns back
+    const int waypoint = terrain.tile_index(get_target());
+    const size_t waypoint_index = std::find(tiles.begin(), tiles.end(), waypoint) - tiles.begin();
+
+    if (waypoint_index >= tiles.size()) set_target(terrain.tile_corner(tiles.front()));
+
+    flow_field = nullptr;
+    hierarchical_route = HierarchicalRoute::from_tiles(std::move(tiles));
+    if (waypoint_index < hierarchical_route.segment.size()) hierarchical_route.segment_index = waypoint_index + 1;
+}
+
 //Start reloading timer
 void Tank::reload_rocket()
 {
@@ -93,7 +109,7 @@ void Tank::reload_rocket()
 
 void Tank::deactivate()
 {
-    active = false;
+    system->deactivate(id);
 }
 
 //Remove health
@@ -107,13 +123,15 @@ bool Tank::hit(int hit_value)
         return true;
     }
 
+    system->health_index.set_health(id, health);
     return false;
 }
 
 //Draw the sprite with the facing based on this tanks movement direction
 void Tank::draw(Surface* screen)
 {
-    vec2 direction = (target - position).normalized();
+    const vec2 position = get_position();
+    vec2 direction = (get_target() - position).normalized();
     tank_sprite->set_frame(((abs(direction.x) > abs(direction.y)) ? ((direction.x < 0) ? 3 : 0) : ((direction.y < 0) ? 9 : 6)) + (current_frame / 3));
     tank_sprite->draw(screen, (int)position.x - 7 + HEALTHBAR_OFFSET, (int)position.y - 9);
 }
@@ -126,7 +144,9 @@ int Tank::compare_health(const Tank& other) const
 //Add some force in a given direction
 void Tank::push(vec2 direction, float magnitude)
 {
-    force += direction * magnitude;
+    const vec2 force = direction * magnitude;
+    system->force_x[id] += force.x;
+    system->force_y[id] += force.y;
 }
 
 } // namespace Tmpl8
\ No newline at end of file
@@ -3,6 +3,7 @@
 namespace Tmpl8
 {
     class Terrain; //forward declare
+    struct FlowField;
 
 enum allignments
 {
@@ -13,17 +14,32 @@ enum allignments
 class Tank
 {
   public:
-    Tank(float pos_x, float pos_y, allignments allignment, Sprite* tank_sprite, Sprite* smoke_sprite, float tar_x, float tar_y, float collision_radius, int health, float max_speed);
+    Tank(TankSystem& system, float pos_x, float pos_y, allignments allignment, Sprite* tank_sprite, Sprite* smoke_sprite, float tar_x, float tar_y, float collision_radius, int health, float max_speed);
 
     ~Tank();
 
+    //Movement is done for all tanks at once by TankSystem::move, this handles the rest (reloading, animation and route)
     void tick(Terrain& terrain);
 
-    vec2 get_position() const { return position; };
+    //Accessors for the hot state that lives in the TankSystem
+    vec2 get_position() const { return vec2(system->position_x[id], system->position_y[id]); };
+    void set_position(vec2 position) { system->position_x[id] = position.x, system->position_y[id] = position.y; };
+    vec2 get_target() const { return vec2(system->target_x[id], system->target_y[id]); };
+    void set_target(vec2 target) { system->target_x[id] = target.x, system->target_y[id] = target.y; };
+    vec2 get_speed() const { return vec2(system->speed_x[id], system->speed_y[id]); };
+    bool is_active() const { return system->is_active(id); };
+
     float get_collision_radius() const { return collision_radius; };
     bool rocket_reloaded() const { return reloaded; };
 
-    void set_route(const std::vector<vec2>& route);
+    //Drive towards the destination of the flow field, tanks that can not reach it stay where they are
+    void follow(const FlowField* flow_field, const Terrain& terrain);
+    void follow(HierarchicalRoute route, const Terrain& terrain);
+
+    //Switch to a re-planned route, the old route is kept if the new one is empty
+    void replace_route(vector<int> tiles, const Terrain& terrain);
+
+    vec2 get_destination() const { return destination; };
     void reload_rocket();
 
     void deactivate();
@@ -35,22 +51,20 @@ class Tank
 
     void push(vec2 direction, float magnitude);
 
-    vec2 position;
-    vec2 speed;
-    vec2 target;
+    TankSystem* system;
+    int id;
 
-    vector<vec2> current_route;
+    vec2 destination;
+    const FlowField* flow_field;
+    HierarchicalRoute hierarchical_route;
 
     int health;
 
     float collision_radius;
-    vec2 force;
 
-    float max_speed;
     float reload_time;
 
     bool reloaded;
-    bool active;
 
     allignments allignment;
 
@@ -0,0 +1,128 @@
+#include "precomp.h"
+#include "tank_grid.h"
+
+namespace Tmpl8
+{
+
+void TankGrid::build(const vector<Tank>& tanks, const vector<int>& live_tanks)
+{
+    const int num_tanks = (int)tanks.size();
+
+    //Find the area covered by the active tanks and the largest collision distance between two of them
+    vec2 min_pos(numeric_limits<float>::max());
+    vec2 max_pos(numeric_limits<float>::lowest());
+    float max_radius = 0.f;
+
+    for (int i : live_tanks)
+    {
+        //A tank with an invalid position never passes a distance check, so leave it out of the grid
+        const Tank& tank = tanks[i];
+        const vec2 position = tank.get_position();
+        if (!std::isfinite(position.x) || !std::isfinite(position.y)) continue;
+
+        min_pos.x = std::min(min_pos.x, position.x);
+        min_pos.y = std::min(min_pos.y, position.y);
+        max_pos.x = std::max(max_pos.x, position.x);
+        max_pos.y = std::max(max_pos.y, position.y);
+        max_radius = std::max(max_radius, tank.collision_radius);
+    }
+
+    //Cells must be at least as big as the collision distance so only the 3x3 neighbouring cells can overlap
+    cell_size = std::max(max_radius * 2.f, 1.f);
+    origin = min_pos;
+
+    if (max_pos.x < min_pos.x)
+    {
+        cells_x = cells_y = 0;
+    }
+    else
+    {
+        const float extent_x = max_pos.x - min_pos.x;
+        const float extent_y = max_pos.y - min_pos.y;
+
+        while (((extent_x / cell_size) + 1.f) * ((extent_y / cell_size) + 1.f) > (float)max_cells)
+        {
+            cell_size *= 2.f;
+        }
+
+        cells_x = (int)(extent_x / cell_size) + 1;
+        cells_y = (int)(extent_y / cell_size) + 1;
+    }
+    inv_cell_size = 1.f / cell_size;
+
+    //Counting sort: count tanks per cell, prefix sum to get the cell ranges, then scatter the indices
+    tank_cells.assign(num_tanks, -1);
+    cell_start.assign((size_t)cells_x * cells_y + 1, 0);
+
+    for (int i : live_tanks)
+    {
+        const vec2 position = tanks[i].get_position();
+        if (!std::isfinite(position.x) || !std::isfinite(position.y)) continue;
+
+        const int cx = std::min((int)((position.x - origin.x) * inv_cell_size), cells_x - 1);
+        const int cy = std::min((int)((position.y - origin.y) * inv_cell_size), cells_y - 1);
+
+        tank_cells[i] = cy * cells_x + cx;
+        cell_start[tank_cells[i] + 1]++;
+    }
+
+    for (size_t c = 1; c < cell_start.size(); c++)
+    {
+        cell_start[c] += cell_start[c - 1];
+    }
+
+    cell_tanks.resize(cell_start.back());
+
+    //Scatter in index order, this keeps the tanks within a cell sorted by index
+    cell_fill.assign(cell_start.begin(), cell_start.end() - 1);
+    for (int i : live_tanks)
+    {
+        if (tank_cells[i] >= 0)
+        {
+            cell_tanks[cell_fill[tank_cells[i]]++] = i;
+        }
+    }
+}
+
+void TankGrid::find_colliding(const vector<Tank>& tanks, int tank_index, vector<int>& colliding) const
+{
+    colliding.clear();
+
+    const int cell = tank_cells[tank_index];
+    if (cell < 0) return;
+
+    const Tank& tank = tanks[tank_index];
+    const int cx = cell % cells_x;
+    const int cy = cell / cells_x;
+
+    for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, cells_y - 1); y++)
+    {
+        for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cells_x - 1); x++)
+        {
+            const int neighbour_cell = y * cells_x + x;
+            for (int i = cell_start[neighbour_cell]; i < cell_start[neighbour_cell + 1]; i++)
+            {
+                const int other_index = cell_tanks[i];
+                if (other_index == tank_index) continue;
+
+                const Tank& other_tank = tanks[other_index];
+
+                vec2 dir = tank.get_position() - other_tank.get_position();
+                float dir_squared_len = dir.sqr_length();
+
+                float col_squared_len = (tank.get_collision_radius() + other_tank.get_collision_radius());
+                col_squared_len *= col_squared_len;
+
+                if (dir_squared_len < col_squared_len)
+                {
+                    colliding.push_back(other_index);
+                }
+            }
+        }
+    }
+
+    //Cells are visited row by row, sort so pushes are applied in the same order as a full scan over all tanks
+    std::sort(colliding.begin(), colliding.end());
+}
+
+} // namespace Tmpl8
@@ -0,0 +1,34 @@
+#pragma once
+
+namespace Tmpl8
+{
+class Tank; //forward declare
+
+//Uniform grid over all active tanks, used to find colliding tanks without testing every pair
+//The grid is rebuilt every frame with a counting sort so each cell is a contiguous range of tank indices
+class TankGrid
+{
+  public:
+    //Only the live tanks are put in the grid
+    void build(const vector<Tank>& tanks, const vector<int>& live_tanks);
+
+    //Collects (in ascending order) the indices of all tanks that overlap the given tank
+    void find_colliding(const vector<Tank>& tanks, int tank_index, vector<int>& colliding) const;
+
+  private:
+    //Hard limit on the number of cells, cells grow when tanks are spread out further than this allows
+    static constexpr int max_cells = 1 << 20;
+
+    vec2 origin;
+    float cell_size = 1.f;
+    float inv_cell_size = 1.f;
+    int cells_x = 0;
+    int cells_y = 0;
+
+    vector<int> tank_cells; //Cell index of each tank, -1 if the tank is not in the grid
+    vector<int> cell_start; //First entry in cell_tanks for each cell (cells + 1 entries)
+    vector<int> cell_tanks; //Tank indices sorted by cell
+    vector<int> cell_fill;  //Next free slot per cell while scattering
+};
+
+} // namespace Tmpl8
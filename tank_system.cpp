@@ -0,0 +1,165 @@
+#include "precomp.h"
+#include "tank_system.h"
+
+namespace Tmpl8
+{
+
+TankSystem::~TankSystem()
+{
+    for (float* data : { position_x, position_y, speed_x, speed_y, force_x, force_y, target_x, target_y, max_speed })
+    {
+        if (data) FREE64(data);
+    }
+}
+
+void TankSystem::reserve(int new_capacity)
+{
+    //Arrays are padded to whole AVX registers, the padding lanes are never active
+    new_capacity = (new_capacity + 7) & ~7;
+    if (new_capacity <= capacity) return;
+
+    for (float** data : { &position_x, &position_y, &speed_x, &speed_y, &force_x, &force_y, &target_x, &target_y, &max_speed })
+    {
+        float* resized = (float*)MALLOC64(new_capacity * sizeof(float));
+        memset(resized, 0, new_capacity * sizeof(float));
+
+        if (*data)
+        {
+            memcpy(resized, *data, count * sizeof(float));
+            FREE64(*data);
+        }
+        *data = resized;
+    }
+
+    capacity = new_capacity;
+    active_bits.resize((capacity + 63) / 64, 0);
+    team.reserve(capacity);
+    live.reserve(capacity);
+}
+
+int TankSystem::add(vec2 position, vec2 target, float max_speed_value, int tank_team, int health)
+{
+    if (count == capacity)
+    {
+        reserve(std::max(capacity * 2, 8));
+    }
+
+    const int index = count++;
+
+    position_x[index] = position.x;
+    position_y[index] = position.y;
+    speed_x[index] = 0.f;
+    speed_y[index] = 0.f;
+    force_x[index] = 0.f;
+    force_y[index] = 0.f;
+    target_x[index] = target.x;
+    target_y[index] = target.y;
+    max_speed[index] = max_speed_value;
+
+    active_bits[index >> 6] |= uint64_t(1) << (index & 63);
+
+    //Indices only increase, so appending keeps the live lists sorted
+    team.push_back(tank_team);
+    live.push_back(index);
+    if ((int)live_per_team.size() <= tank_team) live_per_team.resize(tank_team + 1);
+    live_per_team[tank_team].push_back(index);
+
+    health_index.add(index, tank_team, health);
+
+    return index;
+}
+
+void TankSystem::deactivate(int index)
+{
+    if (!is_active(index)) return;
+
+    active_bits[index >> 6] &= ~(uint64_t(1) << (index & 63));
+
+    //Tanks are destroyed a few times per second at most, so a sorted erase is cheap and keeps loops in index order
+    vector<int>& team_live = live_per_team[team[index]];
+    live.erase(std::lower_bound(live.begin(), live.end(), index));
+    team_live.erase(std::lower_bound(team_live.begin(), team_live.end(), index));
+
+    health_index.remove(index);
+}
+
+//Reference implementation, also used for the remaining tanks when AVX2 is not available
+//Performs the exact same float operations as the vectorized version
+void TankSystem::move_scalar(int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        if (!is_active(i)) continue;
+
+        vec2 direction = vec2(0, 0);
+        const vec2 position(position_x[i], position_y[i]);
+        const vec2 target(target_x[i], target_y[i]);
+
+        if (target != position)
+        {
+            direction = (target - position).normalized();
+        }
+
+        //Update using accumulated force
+        const vec2 speed = direction + vec2(force_x[i], force_y[i]);
+        const vec2 step = speed * max_speed[i] * 0.5f;
+
+        speed_x[i] = speed.x;
+        speed_y[i] = speed.y;
+        position_x[i] = position.x + step.x;
+        position_y[i] = position.y + step.y;
+        force_x[i] = 0.f;
+        force_y[i] = 0.f;
+    }
+}
+
+void TankSystem::move(int begin, int end)
+{
+#ifdef __AVX2__
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    for (int i = begin; i < end; i += 8)
+    {
+        //Lanes past the end belong to the next range
+        const uint32_t lanes = active_lanes(i) & ((end - i >= 8) ? 0xff : ((1u << (end - i)) - 1));
+        if (lanes == 0) continue;
+
+        //Expand the 8 active bits into a full lane mask
+        const __m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)lanes), lane_bits), lane_bits));
+
+        const __m256 pos_x = _mm256_load_ps(position_x + i);
+        const __m256 pos_y = _mm256_load_ps(position_y + i);
+        const __m256 delta_x = _mm256_sub_ps(_mm256_load_ps(target_x + i), pos_x);
+        const __m256 delta_y = _mm256_sub_ps(_mm256_load_ps(target_y + i), pos_y);
+
+        //Normalize the direction to the target, tanks standing on their target get no direction
+        const __m256 moving = _mm256_or_ps(_mm256_cmp_ps(_mm256_load_ps(target_x + i), pos_x, _CMP_NEQ_UQ), _mm256_cmp_ps(_mm256_load_ps(target_y + i), pos_y, _CMP_NEQ_UQ));
+        const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(delta_x, delta_x), _mm256_mul_ps(delta_y, delta_y)));
+        const __m256 inv_length = _mm256_div_ps(one, length);
+        const __m256 dir_x = _mm256_blendv_ps(zero, _mm256_mul_ps(delta_x, inv_length), moving);
+        const __m256 dir_y = _mm256_blendv_ps(zero, _mm256_mul_ps(delta_y, inv_length), moving);
+
+        //Update using accumulated force
+        const __m256 new_speed_x = _mm256_add_ps(dir_x, _mm256_load_ps(force_x + i));
+        const __m256 new_speed_y = _mm256_add_ps(dir_y, _mm256_load_ps(force_y + i));
+        const __m256 limit = _mm256_load_ps(max_speed + i);
+        const __m256 new_pos_x = _mm256_add_ps(pos_x, _mm256_mul_ps(_mm256_mul_ps(new_speed_x, limit), half));
+        const __m256 new_pos_y = _mm256_add_ps(pos_y, _mm256_mul_ps(_mm256_mul_ps(new_speed_y, limit), half));
+
+        //Only write back active lanes
+        _mm256_store_ps(speed_x + i, _mm256_blendv_ps(_mm256_load_ps(speed_x + i), new_speed_x, active));
+        _mm256_store_ps(speed_y + i, _mm256_blendv_ps(_mm256_load_ps(speed_y + i), new_speed_y, active));
+        _mm256_store_ps(position_x + i, _mm256_blendv_ps(pos_x, new_pos_x, active));
+        _mm256_store_ps(position_y + i, _mm256_blendv_ps(pos_y, new_pos_y, active));
+        _mm256_store_ps(force_x + i, _mm256_blendv_ps(_mm256_load_ps(force_x + i), zero, active));
+        _mm256_store_ps(force_y + i, _mm256_blendv_ps(_mm256_load_ps(force_y + i), zero, active));
+    }
+#else
+    move_scalar(begin, end);
+#endif
+}
+
+} // namespace Tmpl8
@@ -0,0 +1,65 @@
+#pragma once
+
+namespace Tmpl8
+{
+
+//Hot tank state (position, speed, force, target, speed limit and active flag) stored as a structure of arrays
+//Tank objects only keep an index into this system, so scans over positions touch contiguous memory
+//and the movement of 8 tanks can be updated at once with AVX2
+class TankSystem
+{
+  public:
+    TankSystem() = default;
+    ~TankSystem();
+
+    TankSystem(const TankSystem&) = delete;
+    TankSystem& operator=(const TankSystem&) = delete;
+
+    void reserve(int new_capacity);
+
+    //Adds an active tank of the given team and returns its index
+    int add(vec2 position, vec2 target, float max_speed, int team, int health);
+
+    int size() const { return count; }
+
+    //Move all active tanks in [begin, end): steer towards the target, apply the accumulated force and advance
+    //The force of every moved tank is reset afterwards, begin must be a multiple of 8
+    void move(int begin, int end);
+
+    bool is_active(int index) const { return (active_bits[index >> 6] >> (index & 63)) & 1; }
+    void deactivate(int index);
+
+    //Indices of the active tanks in ascending order, of all teams and of one team
+    //Loops over these skip destroyed tanks without testing them
+    const vector<int>& live_tanks() const { return live; }
+    const vector<int>& live_tanks(int team) const { return live_per_team[team]; }
+
+    float* position_x = nullptr;
+    float* position_y = nullptr;
+    float* speed_x = nullptr;
+    float* speed_y = nullptr;
+    float* force_x = nullptr;
+    float* force_y = nullptr;
+    float* target_x = nullptr;
+    float* target_y = nullptr;
+    float* max_speed = nullptr;
+
+    //Active tanks ordered on health, Tank::hit keeps it up to date
+    HealthIndex health_index;
+
+  private:
+    //Returns the active flags of the 8 tanks starting at index (which must be a multiple of 8)
+    uint32_t active_lanes(int index) const { return (uint32_t)(active_bits[index >> 6] >> (index & 63)) & 0xff; }
+
+    void move_scalar(int begin, int end);
+
+    int count = 0;
+    int capacity = 0;
+
+    vector<uint64_t> active_bits;
+    vector<int> team;
+    vector<int> live;
+    vector<vector<int>> live_per_team;
+};
+
+} // namespace Tmpl8
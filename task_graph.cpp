@@ -0,0 +1,146 @@
+#include "precomp.h"
+#include "task_graph.h"
+
+namespace Tmpl8
+{
+
+int TaskGraph::add(const char* name, uint32_t reads, uint32_t writes, std::function<void()> work)
+{
+    const int index = (int)nodes.size();
+
+    Node node;
+    node.name = name;
+    node.reads = reads;
+    node.writes = writes;
+    node.work = std::move(work);
+
+    //Read after write, write after read and write after write all need the earlier item to finish first
+    for (int i = 0; i < index; i++)
+    {
+        Node& earlier = nodes[i];
+        if ((earlier.writes & (reads | writes)) || (earlier.reads & writes))
+        {
+            node.predecessors.push_back(i);
+            earlier.successors.push_back(index);
+        }
+    }
+
+    nodes.push_back(std::move(node));
+    return index;
+}
+
+void TaskGraph::run(ThreadPool& pool)
+{
+    const int count = (int)nodes.size();
+    if (count == 0) return;
+
+    if (waiting_size != count)
+    {
+        waiting.reset(new std::atomic<int>[count]);
+        waiting_size = count;
+
+        jobs.resize(count);
+        root_jobs.clear();
+        for (int i = 0; i < count; i++)
+        {
+            jobs[i].graph = this;
+            jobs[i].index = i;
+            if (nodes[i].predecessors.empty() && i > 0) root_jobs.push_back(&jobs[i]);
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        waiting[i].store((int)nodes[i].predecessors.size(), std::memory_order_relaxed);
+        jobs[i].pool = &pool;
+    }
+    unfinished.store(count, std::memory_order_relaxed);
+
+    run_start = std::chrono::steady_clock::now();
+
+    //Queue every item without dependencies at once, except the first item which runs on this thread
+    if (!root_jobs.empty()) pool.submit(root_jobs.data(), (int)root_jobs.size());
+
+    run_node(pool, 0);
+    pool.help_until([this]() { return unfinished.load(std::memory_order_acquire) == 0; });
+
+    run_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - run_start).count();
+    find_critical_path();
+}
+
+void TaskGraph::run_node(ThreadPool& pool, int index)
+{
+    Node& node = nodes[index];
+
+    node.thread = ThreadPool::current_thread();
+    node.start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - run_start).count();
+    node.work();
+    node.end_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - run_start).count();
+
+    //Continue with the first successor that became ready on this thread, queue the others
+    int next = -1;
+    for (int successor : node.successors)
+    {
+        if (waiting[successor].fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+
+        if (next < 0)
+        {
+            next = successor;
+        }
+        else
+        {
+            Task* job = &jobs[successor];
+            pool.submit(&job, 1);
+        }
+    }
+
+    //Last access to this graph when nothing follows, run may return after this
+    unfinished.fetch_sub(1, std::memory_order_release);
+
+    if (next >= 0) run_node(pool, next);
+}
+
+// -----------------------------------------------------------
+// Walks back from the item that finished last, every step goes to the predecessor that finished last
+// That predecessor is the one the item actually had to wait for
+// -----------------------------------------------------------
+void TaskGraph::find_critical_path()
+{
+    int last = 0;
+    for (int i = 0; i < (int)nodes.size(); i++)
+    {
+        nodes[i].critical = false;
+        if (nodes[i].end_ns > nodes[last].end_ns) last = i;
+    }
+
+    critical_ns = 0;
+    for (int i = last; i >= 0;)
+    {
+        Node& node = nodes[i];
+        node.critical = true;
+        critical_ns += node.end_ns - node.start_ns;
+
+        int latest = -1;
+        for (int predecessor : node.predecessors)
+        {
+            if (latest < 0 || nodes[predecessor].end_ns > nodes[latest].end_ns) latest = predecessor;
+        }
+        i = latest;
+    }
+}
+
+void TaskGraph::print_trace(std::ostream& out) const
+{
+    char line[128];
+
+    snprintf(line, sizeof(line), "%.3f ms, critical path %.3f ms\n", run_ns / 1e6, critical_ns / 1e6);
+    out << line;
+
+    for (const Node& node : nodes)
+    {
+        snprintf(line, sizeof(line), "  %c %-24s %8.3f - %8.3f ms  thread %d\n", node.critical ? '*' : ' ', node.name, node.start_ns / 1e6, node.end_ns / 1e6, node.thread);
+        out << line;
+    }
+}
+
+} // namespace Tmpl8
@@ -0,0 +1,65 @@
+#pragma once
+
+namespace Tmpl8
+{
+
+//Fixed set of work items that is run once per frame, items that do not share data run at the same time
+//Every item declares the data it reads and writes as bit masks. An item waits for every earlier added item that
+//writes data it uses or reads data it writes, so the outcome is the same as running them in the order they were added
+class TaskGraph
+{
+  public:
+    //Adds an item, returns its index
+    int add(const char* name, uint32_t reads, uint32_t writes, std::function<void()> work);
+
+    //Runs all items on the pool and returns when they are done, the calling thread helps
+    void run(ThreadPool& pool);
+
+    //Timings of the last run, items on the critical path are marked with a *
+    void print_trace(std::ostream& out) const;
+
+  private:
+    struct Node
+    {
+        const char* name;
+        uint32_t reads;
+        uint32_t writes;
+        std::function<void()> work;
+        vector<int> predecessors;
+        vector<int> successors;
+
+        //Trace of the last run, times in nanoseconds since the start of the run
+        int64_t start_ns = 0;
+        int64_t end_ns = 0;
+        int thread = 0;
+        bool critical = false;
+    };
+
+    //Queued on the pool when its node becomes ready, there is one per node so a run does not allocate
+    class NodeJob final : public Task
+    {
+      public:
+        void run() override { graph->run_node(*pool, index); }
+
+        TaskGraph* graph = nullptr;
+        ThreadPool* pool = nullptr;
+        int index = 0;
+    };
+
+    void run_node(ThreadPool& pool, int index);
+    void find_critical_path();
+
+    vector<Node> nodes;
+
+    std::unique_ptr<std::atomic<int>[]> waiting; //Unfinished predecessors per node during a run
+    int waiting_size = 0;
+    vector<NodeJob> jobs;
+    vector<Task*> root_jobs; //Jobs of the items without dependencies except the first, which runs on the calling thread
+    std::atomic<int> unfinished{ 0 };
+
+    std::chrono::steady_clock::time_point run_start;
+    int64_t run_ns = 0;
+    int64_t critical_ns = 0;
+};
+
+} // namespace Tmpl8
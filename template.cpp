@@ -219,6 +219,37 @@ void swap()
 int main(int argc, char** argv)
 {
     printf("application started.\n");
+
+    //"--route-benchmark" compares the route searches on the terrain in the console and exits
+    //"--convert-terrain <text map> <binary map>" converts a text map to the binary format and exits
+    //"--replan-check <frames>" runs that many frames with re-planning on the default routes without a window, it fails if no tank switched routes
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--route-benchmark") == 0)
+        {
+            Terrain().benchmark_route_searches(std::cout);
+            return 0;
+        }
+        if (strcmp(argv[i], "--convert-terrain") == 0 && i + 2 < argc)
+        {
+            const bool converted = Terrain::convert_text_map(argv[i + 1], argv[i + 2]);
+            printf(converted ? "Converted %s to %s.\n" : "Could not convert %s to %s.\n", argv[i + 1], argv[i + 2]);
+            return converted ? 0 : 1;
+        }
+        if (strcmp(argv[i], "--replan-check") == 0 && i + 1 < argc)
+        {
+            surface = new Surface(SCRWIDTH, SCRHEIGHT);
+            game = new Game();
+            game->set_replan_interval(4);
+            game->set_target(surface);
+            game->init();
+            for (int frame = atoi(argv[i + 1]); frame > 0; frame--) game->tick(0.f);
+
+            const int replanned = game->replanned_route_count();
+            printf("%i routes re-planned.\n", replanned);
+            return (replanned > 0) ? 0 : 1;
+        }
+    }
     SDL_Init(SDL_INIT_VIDEO);
 
 #ifdef ADVANCEDGL
@@ -243,6 +274,17 @@ int main(int argc, char** argv)
 #endif
     int exitapp = 0;
     game = new Game();
+    //Optional "--threads <count>" argument, defaults to the number of hardware threads
+    //"--trace" prints the timings of the update phases every frame
+    //"--hierarchical" routes the tanks with hierarchical path finding instead of flow fields
+    //"--replan <frames>" gives every tank a new route every number of frames
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) game->set_thread_count(atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--trace") == 0) game->set_trace_frames(true);
+        if (strcmp(argv[i], "--hierarchical") == 0) game->set_hierarchical_routes(true);
+        if (strcmp(argv[i], "--replan") == 0 && i + 1 < argc) game->set_replan_interval(atoi(argv[i + 1]));
+    }
     game->set_target(surface);
     timer t;
     t.reset();
@@ -252,23 +294,12 @@ int main(int argc, char** argv)
         swap();
         surface->SetBuffer((Pixel*)framedata);
 #else
-        void* target = 0;
-        int pitch;
-        SDL_LockTexture(frameBuffer, NULL, &target, &pitch);
-        if (pitch == (surface->get_width() * 4))
+        //Only the rows that changed in the last tick are copied, the texture keeps the others
+        for (const std::pair<int, int>& rows : game->changed_rows())
         {
-            memcpy(target, surface->get_buffer(), SCRWIDTH * SCRHEIGHT * 4);
-        }
-        else
-        {
-            unsigned char* t = (unsigned char*)target;
-            for (int i = 0; i < SCRHEIGHT; i++)
-            {
-                memcpy(t, surface->get_buffer() + i * SCRWIDTH, SCRWIDTH * 4);
-                t += pitch;
-            }
+            const SDL_Rect rect = { 0, rows.first, SCRWIDTH, rows.second - rows.first };
+            SDL_UpdateTexture(frameBuffer, &rect, surface->get_buffer() + rows.first * SCRWIDTH, SCRWIDTH * 4);
         }
-        SDL_UnlockTexture(frameBuffer);
         SDL_RenderCopy(renderer, frameBuffer, NULL, NULL);
         SDL_RenderPresent(renderer);
 #endif
@@ -21,89 +21,228 @@ namespace Tmpl8
         tile_mountains = std::make_unique<Sprite>(mountains_img.get(), 1);
 
 
-        //Load terrain layout file and fill grid based on tiletypes
-        fs::path terrain_file_path{ "assets/terrain.txt" };
-        std::ifstream terrain_file(terrain_file_path);
+#ifdef BAKED_TERRAIN
+        //A baked build always plays the map it was built with, assets/terrain.map and assets/terrain.txt are not read
+        width = baked_terrain::width;
+        height = baked_terrain::height;
+        tiles = baked_terrain::tiles;
+#else
+        //Load the binary map if it was converted, the text map otherwise
+        const fs::path binary_map_path{ "assets/terrain.map" };
+        const fs::path text_map_path{ "assets/terrain.txt" };
+
+        if (!load_binary_map(binary_map_path))
+        {
+            if (!parse_text_map(text_map_path, width, height, tile_storage))
+            {
+                std::cout << "Could not open terrain file! Is the path correct? Defaulting to grass.." << std::endl;
+                std::cout << "Path was: " << text_map_path << std::endl;
+
+                width = 80;
+                height = 45;
+                tile_storage.assign((size_t)width * height, TileType::GRASS | tile_passable);
+            }
+            tiles = tile_storage.data();
+        }
+#endif
+
+        init_path_planning();
+    }
 
-        if (terrain_file.is_open())
+    bool Terrain::load_binary_map(const fs::path& binary_path)
+    {
+        if (!map_file.open(binary_path)) return false;
+
+        MapHeader header;
+        if (map_file.get_size() < sizeof(header))
         {
-            std::string terrain_line;
+            map_file.close();
+            return false;
+        }
 
-            std::getline(terrain_file, terrain_line);
-            std::istringstream lineStream(terrain_line);
+        //The tiles are used straight from the mapping
+        std::memcpy(&header, map_file.get_data(), sizeof(header));
+        if (std::memcmp(header.magic, "TMAP", sizeof(header.magic)) != 0 || header.version != 1 || map_file.get_size() != sizeof(header) + (size_t)header.width * header.height)
+        {
+            std::cout << "Terrain map has an unknown format, it is ignored." << std::endl;
+            std::cout << "Path was: " << binary_path << std::endl;
+            map_file.close();
+            return false;
+        }
 
-            int rows;
+        width = (int)header.width;
+        height = (int)header.height;
+        tiles = map_file.get_data() + sizeof(header);
+        return true;
+    }
 
-            lineStream >> rows;
+    bool Terrain::parse_text_map(const fs::path& text_path, int& width, int& height, vector<uint8_t>& tiles)
+    {
+        //Read the whole file at once, the first line holds the number of rows
+        std::ifstream text_file(text_path, std::ios::binary);
+        if (!text_file.is_open()) return false;
 
-            for (size_t row = 0; row < rows; row++)
-            {
-                std::getline(terrain_file, terrain_line);
+        const std::string text((std::istreambuf_iterator<char>(text_file)), std::istreambuf_iterator<char>());
+
+        size_t line_start = text.find('\n');
+        if (line_start == std::string::npos) return false;
+
+        height = std::max(std::atoi(text.c_str()), 0);
+        line_start++;
+
+        //The widest row sets the width, short rows are filled up with grass
+        vector<std::pair<size_t, size_t>> rows;
+        rows.reserve(height);
+        width = 0;
+        for (int row = 0; row < height; row++)
+        {
+            size_t line_end = std::min(text.find('\n', line_start), text.size());
+            const size_t next_line = std::min(line_end + 1, text.size());
+            if (line_end > line_start && text[line_end - 1] == '\r') line_end--;
+
+            rows.emplace_back(std::min(line_start, text.size()), std::min(line_end, text.size()));
+            width = std::max(width, (int)(rows.back().second - rows.back().first));
+            line_start = next_line;
+        }
 
-                for (size_t collumn = 0; collumn < terrain_line.size(); collumn++)
+        tiles.assign((size_t)width * height, TileType::GRASS | tile_passable);
+        for (int row = 0; row < height; row++)
+        {
+            uint8_t* tile = tiles.data() + (size_t)row * width;
+            for (size_t column = rows[row].first; column < rows[row].second; column++, tile++)
+            {
+                switch (std::toupper(text[column]))
                 {
-                    switch (std::toupper(terrain_line.at(collumn)))
-                    {
-                    case 'G':
-                        tiles.at(row).at(collumn).tile_type = TileType::GRASS;
-                        break;
-                    case 'F':
-                        tiles.at(row).at(collumn).tile_type = TileType::FORREST;
-                        break;
-                    case 'R':
-                        tiles.at(row).at(collumn).tile_type = TileType::ROCKS;
-                        break;
-                    case 'M':
-                        tiles.at(row).at(collumn).tile_type = TileType::MOUNTAINS;
-                        break;
-                    case 'W':
-                        tiles.at(row).at(collumn).tile_type = TileType::WATER;
-                        break;
-                    default:
-                        tiles.at(row).at(collumn).tile_type = TileType::GRASS;
-                        break;
-                    }
+                case 'F':
+                    *tile = TileType::FORREST | tile_passable;
+                    break;
+                case 'R':
+                    *tile = TileType::ROCKS | tile_passable;
+                    break;
+                case 'M':
+                    *tile = TileType::MOUNTAINS;
+                    break;
+                case 'W':
+                    *tile = TileType::WATER;
+                    break;
+                default:
+                    *tile = TileType::GRASS | tile_passable;
+                    break;
                 }
             }
         }
-        else
+
+        return true;
+    }
+
+    bool Terrain::convert_text_map(const fs::path& text_path, const fs::path& binary_path)
+    {
+        int width, height;
+        vector<uint8_t> tiles;
+        if (!parse_text_map(text_path, width, height, tiles)) return false;
+
+        const MapHeader header{ { 'T', 'M', 'A', 'P' }, 1, (uint32_t)width, (uint32_t)height };
+        std::ofstream binary_file(binary_path, std::ios::binary | std::ios::trunc);
+        binary_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        binary_file.write(reinterpret_cast<const char*>(tiles.data()), tiles.size());
+
+        return binary_file.good();
+    }
+
+    void Terrain::init_path_planning()
+    {
+        //Cost of every possible tile byte (type and passable bit), so the grid is filled with a lookup per tile
+        float byte_costs[tile_type_mask + tile_passable + 1];
+        for (int byte = 0; byte <= tile_type_mask + tile_passable; byte++)
         {
-            std::cout << "Could not open terrain file! Is the path correct? Defaulting to grass.." << std::endl;
-            std::cout << "Path was: " << terrain_file_path << std::endl;
+            byte_costs[byte] = (byte & tile_passable) ? tile_cost((TileType)(byte & tile_type_mask)) : numeric_limits<float>::infinity();
         }
 
-        //Instantiate tiles for path planning
-        for (size_t y = 0; y < tiles.size(); y++)
+        //Flat cost grid for path planning, one pass over the tiles that also finds out if all open tiles cost the same
+        costs.resize((size_t)width * height);
+        uint8_t open_tiles_or = 0, open_tiles_and = 0xFF;
+        for (size_t tile = 0; tile < costs.size(); tile++)
         {
-            for (size_t x = 0; x < tiles.at(y).size(); x++)
-            {
-                tiles.at(y).at(x).position_x = x;
-                tiles.at(y).at(x).position_y = y;
+            const uint8_t byte = tiles[tile] & (tile_type_mask | tile_passable);
+            costs[tile] = byte_costs[byte];
 
-                if (is_accessible(y, x + 1)) { tiles.at(y).at(x).exits.push_back(&tiles.at(y).at(x + 1)); }
-                if (is_accessible(y, x - 1)) { tiles.at(y).at(x).exits.push_back(&tiles.at(y).at(x - 1)); }
-                if (is_accessible(y + 1, x)) { tiles.at(y).at(x).exits.push_back(&tiles.at(y + 1).at(x)); }
-                if (is_accessible(y - 1, x)) { tiles.at(y).at(x).exits.push_back(&tiles.at(y - 1).at(x)); }
-            }
+            const uint8_t open_mask = (byte & tile_passable) ? 0xFF : 0;
+            open_tiles_or |= byte & open_mask;
+            open_tiles_and &= byte | ~open_mask;
         }
+
+        //All open tiles have the same type when the or and the and of their bytes match
+        uniform_cost = open_tiles_or == 0 || open_tiles_or == open_tiles_and;
+    }
+
+    void Terrain::prepare_hierarchical_routes()
+    {
+        if (cluster_graph.node_count() == 0) cluster_graph.build(width, height, costs);
     }
 
     void Terrain::update()
     {
         //Pretend there is animation code here.. next year :)
+        //Animated tiles would set background_dirty
+    }
+
+    int Terrain::visible_columns() const
+    {
+        return std::min(width, (SCRWIDTH - HEALTHBAR_OFFSET + sprite_size - 1) / sprite_size);
+    }
+
+    int Terrain::visible_rows() const
+    {
+        return std::min(height, (SCRHEIGHT + sprite_size - 1) / sprite_size);
+    }
+
+    void Terrain::draw(Surface* target)
+    {
+        //The terrain does not change between frames, so it is rendered once and restored with a copy per row
+        if (!background || background->get_width() != target->get_width() || background->get_height() != target->get_height())
+        {
+            background = std::make_unique<Surface>(target->get_width(), target->get_height());
+            background_dirty = true;
+        }
+
+        if (background_dirty)
+        {
+            background->clear(0);
+            draw_tiles(background.get(), tiles, width, visible_columns(), visible_rows(), HEALTHBAR_OFFSET, 0);
+            background_dirty = false;
+        }
+
+        background->copy_to(target, 0, 0);
+    }
+
+    bool Terrain::background_changed(Surface* target) const
+    {
+        return !background || background_dirty || background->get_width() != target->get_width() || background->get_height() != target->get_height();
     }
 
-    void Terrain::draw(Surface* target) const
+    void Terrain::restore(Surface* target, const ScreenRect& rect) const
     {
+        const Pixel* src = background->get_buffer() + rect.y1 * background->get_pitch() + rect.x1;
+        Pixel* dst = target->get_buffer() + rect.y1 * target->get_pitch() + rect.x1;
 
-        for (size_t y = 0; y < tiles.size(); y++)
+        for (int y = rect.y1; y < rect.y2; y++)
+        {
+            std::memcpy(dst, src, (rect.x2 - rect.x1) * sizeof(Pixel));
+            src += background->get_pitch();
+            dst += target->get_pitch();
+        }
+    }
+
+    void Terrain::draw_tiles(Surface* target, const uint8_t* tile_bytes, int pitch, int columns, int rows, int pos_x, int pos_y) const
+    {
+        for (int y = 0; y < rows; y++)
         {
-            for (size_t x = 0; x < tiles.at(y).size(); x++)
+            for (int x = 0; x < columns; x++)
             {
-                int posX = (x * sprite_size) + HEALTHBAR_OFFSET;
-                int posY = y * sprite_size;
+                int posX = (x * sprite_size) + pos_x;
+                int posY = (y * sprite_size) + pos_y;
 
-                switch (tiles.at(y).at(x).tile_type)
+                switch ((TileType)(tile_bytes[y * pitch + x] & tile_type_mask))
                 {
                 case TileType::GRASS:
                     tile_grass->draw(target, posX, posY);
@@ -128,129 +267,406 @@ namespace Tmpl8
         }
     }
 
-    // ZOEKOPDRACHT MET A*
-
-    vector<vec2> Terrain::get_route(const Tank& tank, const vec2& target)
+    void Terrain::benchmark_route_searches(std::ostream& out) const
     {
-        //Find start and target tile
-        const size_t pos_x = tank.position.x / sprite_size;
-        const size_t pos_y = tank.position.y / sprite_size;
+        //All searches run on the passability grid with the same cost on every open tile, so they find routes of the same length
+        vector<float> uniform_costs(costs.size());
+        std::transform(costs.begin(), costs.end(), uniform_costs.begin(), [](float cost) { return std::isfinite(cost) ? 1.0f : cost; });
 
-        const size_t target_x = target.x / sprite_size;
-        const size_t target_y = target.y / sprite_size;
+        vector<int> open_tiles;
+        for (int tile = 0; tile < (int)costs.size(); tile++)
+        {
+            if (std::isfinite(costs[tile])) open_tiles.push_back(tile);
+        }
+        if (open_tiles.empty()) return;
 
-        //Init queue with start tile
-        std::queue<vector<TerrainTile*>> queue;
-        queue.emplace();
-        queue.back().push_back(&tiles.at(pos_y).at(pos_x));
+        //Fixed pairs so runs can be compared
+        constexpr int route_count = 2000;
+        vector<std::pair<int, int>> pairs(route_count);
+        uint32_t random = 2463534242u;
+        for (auto& pair : pairs)
+        {
+            random ^= random << 13, random ^= random >> 17, random ^= random << 5;
+            pair.first = open_tiles[random % open_tiles.size()];
+            random ^= random << 13, random ^= random >> 17, random ^= random << 5;
+            pair.second = open_tiles[random % open_tiles.size()];
+        }
+
+        using Search = vector<int> (*)(const vector<float>&, int, const GridRegion&, int, int, GridSearchStats*);
+        const std::pair<const char*, Search> searches[] = { { "BFS", breadth_first_search }, { "A*", a_star_search }, { "JPS", jump_point_search } };
 
-        std::vector<TerrainTile*> visited;
+        const GridRegion region{ 0, 0, width, height };
+        vector<size_t> reference_lengths;
 
-        bool route_found = false;
-        vector<TerrainTile*> current_route;
-        while (!queue.empty() && !route_found)
+        out << "Route searches over " << route_count << " routes on the " << width << "x" << height << " passability grid:" << std::endl;
+        for (const auto& search : searches)
         {
-            current_route = queue.front();
-            queue.pop();
-            TerrainTile* current_tile = current_route.back();
+            GridSearchStats stats;
+            size_t total_length = 0;
+            bool same_lengths = true;
 
-            //Check all exits, if target then done, else if unvisited push a new partial route
-            for (TerrainTile* exit : current_tile->exits)
+            timer search_timer;
+            for (size_t i = 0; i < pairs.size(); i++)
             {
-                if (exit->position_x == target_x && exit->position_y == target_y)
-                {
-                    current_route.push_back(exit);
-                    route_found = true;
-                    break;
-                }
-                else if (!exit->visited)
-                {
-                    exit->visited = true;
-                    visited.push_back(exit);
-                    queue.push(current_route);
-                    queue.back().push_back(exit);
-                }
+                const size_t length = search.second(uniform_costs, width, region, pairs[i].first, pairs[i].second, &stats).size();
+                total_length += length;
+
+                if (reference_lengths.size() < pairs.size()) reference_lengths.push_back(length);
+                else same_lengths = same_lengths && reference_lengths[i] == length;
             }
+            const float elapsed = search_timer.elapsed();
 
-            // EINDE VERBETERING
+            out << "  " << search.first << ": " << stats.expansions << " expansions, " << elapsed << " ms, " << total_length << " route tiles" << (same_lengths ? "" : " (route lengths differ from BFS!)") << std::endl;
+        }
+    }
 
-/* ORIGINELE CODE
-    //Use Breadth-first search to find shortest route to the destination
-    vector<vec2> Terrain::get_route(const Tank& tank, const vec2& target)
+    vector<int> Terrain::get_route(int start, int goal) const
     {
-        //Find start and target tile
-        const size_t pos_x = tank.position.x / sprite_size;
-        const size_t pos_y = tank.position.y / sprite_size;
+        if (start < 0 || goal < 0 || !std::isfinite(costs[goal])) return {};
 
-        const size_t target_x = target.x / sprite_size;
-        const size_t target_y = target.y / sprite_size;
+        //With the next hop table the route can be followed without searching
+        if (next_hops != nullptr)
+        {
+            const uint8_t* hops = next_hops + (size_t)goal * costs.size();
 
-        //Init queue with start tile
-        std::queue<vector<TerrainTile*>> queue;
-        queue.emplace();
-        queue.back().push_back(&tiles.at(pos_y).at(pos_x));
+            vector<int> route{ start };
+            for (int tile = start; tile != goal;)
+            {
+                if (hops[tile] == HOP_NONE) return {};
 
-        std::vector<TerrainTile*> visited;
+                tile = hop_step(tile, hops[tile]);
+                route.push_back(tile);
+            }
+            return route;
+        }
 
-        bool route_found = false;
-        vector<TerrainTile*> current_route;
-        while (!queue.empty() && !route_found)
-        {
-            current_route = queue.front();
-            queue.pop();
-            TerrainTile* current_tile = current_route.back();
+        //Jump point search skips the symmetric routes when all open tiles cost the same, otherwise A* takes the tile costs into account
+        const GridRegion region{ 0, 0, width, height };
+        return uniform_cost ? jump_point_search(costs, width, region, start, goal) : a_star_search(costs, width, region, start, goal);
+    }
 
-            //Check all exits, if target then done, else if unvisited push a new partial route
-            for (TerrainTile * exit : current_tile->exits)
+    vector<vector<int>> Terrain::get_routes(const vector<Tank>& tanks, ThreadPool& pool) const
+    {
+        //Searches keep their state per thread, so the routes are independent
+        vector<vector<int>> routes(tanks.size());
+        pool.parallel_for(0, (int)tanks.size(), 8, [this, &tanks, &routes](int begin, int end) {
+            for (int i = begin; i < end; i++)
             {
-                if (exit->position_x == target_x && exit->position_y == target_y)
-                {
-                    current_route.push_back(exit);
-                    route_found = true;
-                    break;
-                }
-                else if (!exit->visited)
-                {
-                    exit->visited = true;
-                    visited.push_back(exit);
-                    queue.push(current_route);
-                    queue.back().push_back(exit);
-                }
+                routes[i] = get_route(tile_index(tanks[i].get_position()), tile_index(tanks[i].get_target()));
             }
+        });
+        return routes;
+    }
+
+    const FlowField* Terrain::get_flow_field(const vec2& destination)
+    {
+        const int goal = tile_index(destination);
+        if (goal < 0 || !std::isfinite(costs[goal])) return nullptr;
 
-*/
-//Reset tiles
-            for (TerrainTile* tile : visited)
+        std::unique_ptr<FlowField>& flow_field = flow_fields[goal];
+        if (!flow_field) flow_field = build_flow_field(goal);
+        return flow_field.get();
+    }
+
+    vector<const FlowField*> Terrain::get_flow_fields(const vector<vec2>& destinations, ThreadPool& pool)
+    {
+        //Find the destinations without a field first, each of them is built once by one task
+        vector<int> missing;
+        for (const vec2& destination : destinations)
+        {
+            const int goal = tile_index(destination);
+            if (goal >= 0 && std::isfinite(costs[goal]) && flow_fields.count(goal) == 0 && std::find(missing.begin(), missing.end(), goal) == missing.end())
             {
-                tile->visited = false;
+                missing.push_back(goal);
             }
+        }
 
-            if (route_found)
+        vector<std::unique_ptr<FlowField>> built(missing.size());
+        pool.parallel_for(0, (int)missing.size(), 1, [this, &missing, &built](int begin, int end) {
+            for (int i = begin; i < end; i++)
             {
-                //Convert route to vec2 to prevent dangling pointers
-                std::vector<vec2> route;
-                for (TerrainTile* tile : current_route)
+                built[i] = build_flow_field(missing[i]);
+            }
+        });
+
+        for (size_t i = 0; i < missing.size(); i++)
+        {
+            flow_fields[missing[i]] = std::move(built[i]);
+        }
+
+        vector<const FlowField*> result(destinations.size());
+        for (size_t i = 0; i < destinations.size(); i++)
+        {
+            result[i] = get_flow_field(destinations[i]);
+        }
+        return result;
+    }
+
+    std::unique_ptr<FlowField> Terrain::build_flow_field(int goal) const
+    {
+        if (next_hops == nullptr) return search_flow_field(goal);
+
+        //The table holds the field already, only the directions have to be turned into tile indices
+        auto flow_field = std::make_unique<FlowField>();
+        flow_field->destination = goal;
+        flow_field->next_tile.resize(costs.size());
+
+        const uint8_t* hops = next_hops + (size_t)goal * costs.size();
+        for (int tile = 0; tile < (int)costs.size(); tile++)
+        {
+            flow_field->next_tile[tile] = (hops[tile] == HOP_NONE) ? -1 : hop_step(tile, hops[tile]);
+        }
+        return flow_field;
+    }
+
+    std::unique_ptr<FlowField> Terrain::search_flow_field(int goal) const
+    {
+        auto flow_field = std::make_unique<FlowField>();
+        flow_field->destination = goal;
+        flow_field->next_tile.assign(costs.size(), -1);
+
+        PathScratch& scratch = thread_scratch();
+        scratch.begin(costs.size());
+        const uint32_t search_epoch = scratch.epoch;
+        vector<float>& path_cost = scratch.path_cost;
+        vector<uint32_t>& seen_stamp = scratch.seen_stamp;
+        vector<uint32_t>& closed_stamp = scratch.closed_stamp;
+        vector<std::pair<float, int>>& open_heap = scratch.open_heap;
+
+        //Dijkstra outwards from the destination, path_cost holds the cost of the fastest route from a tile to the destination
+        auto heap_order = [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; };
+
+        path_cost[goal] = 0.f;
+        seen_stamp[goal] = search_epoch;
+        open_heap.emplace_back(0.f, goal);
+
+        while (!open_heap.empty())
+        {
+            std::pop_heap(open_heap.begin(), open_heap.end(), heap_order);
+            const int current = open_heap.back().second;
+            open_heap.pop_back();
+
+            if (closed_stamp[current] == search_epoch) continue;
+            closed_stamp[current] = search_epoch;
+
+            //Tanks on tiles that can not be crossed may still drive off them, but no route goes through them
+            if (!std::isfinite(costs[current])) continue;
+
+            const int x = current % width;
+            const int y = current / width;
+            const int neighbours[4] = { (x + 1 < width) ? current + 1 : -1, (x > 0) ? current - 1 : -1, (y + 1 < height) ? current + width : -1, (y > 0) ? current - width : -1 };
+
+            for (int previous : neighbours)
+            {
+                if (previous < 0 || closed_stamp[previous] == search_epoch) continue;
+
+                //Driving from the neighbour onto the current tile costs the time it takes to cross the current tile
+                const float cost = path_cost[current] + costs[current];
+                if (seen_stamp[previous] != search_epoch || cost < path_cost[previous])
                 {
-                    route.push_back(vec2((float)tile->position_x * sprite_size, (float)tile->position_y * sprite_size));
-                }
+                    seen_stamp[previous] = search_epoch;
+                    path_cost[previous] = cost;
+                    flow_field->next_tile[previous] = current;
 
-                return route;
+                    open_heap.emplace_back(cost, previous);
+                    std::push_heap(open_heap.begin(), open_heap.end(), heap_order);
+                }
             }
-            else
+        }
+
+        return flow_field;
+    }
+
+    bool Terrain::load_next_hop_table(ThreadPool& pool)
+    {
+        //The table grows with the square of the tile count
+        if (prefers_hierarchical_routes()) return false;
+
+        const fs::path table_path{ "assets/terrain.nexthop" };
+        if (map_next_hop_table(table_path)) return true;
+
+        //Build the table with a flow field search from every destination, destinations are independent
+        std::cout << "Building next hop table for " << costs.size() << " tiles.." << std::endl;
+
+        const size_t tile_count = costs.size();
+        vector<uint8_t> table(tile_count * tile_count, HOP_NONE);
+        pool.parallel_for(0, (int)tile_count, 16, [this, tile_count, &table](int begin, int end) {
+            for (int goal = begin; goal < end; goal++)
             {
-                return  std::vector<vec2>();
+                if (!std::isfinite(costs[goal])) continue;
+
+                const std::unique_ptr<FlowField> flow_field = search_flow_field(goal);
+                uint8_t* hops = table.data() + (size_t)goal * tile_count;
+                for (int tile = 0; tile < (int)tile_count; tile++)
+                {
+                    if (flow_field->next_tile[tile] >= 0) hops[tile] = hop_direction(tile, flow_field->next_tile[tile]);
+                }
             }
+        });
+
+        NextHopHeader header{ { 'N', 'E', 'X', 'T', 'H', 'O', 'P', '1' }, layout_hash(), (uint32_t)width, (uint32_t)height };
+        {
+            std::ofstream table_file(table_path, std::ios::binary | std::ios::trunc);
+            table_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            table_file.write(reinterpret_cast<const char*>(table.data()), table.size());
+        }
+
+        if (map_next_hop_table(table_path)) return true;
+
+        std::cout << "Could not write next hop table, routes are searched instead." << std::endl;
+        std::cout << "Path was: " << table_path << std::endl;
+        return false;
+    }
+
+    bool Terrain::plan_route(HierarchicalRoute& route, const vec2& start, const vec2& destination) const
+    {
+        route = HierarchicalRoute();
+
+        const int start_tile = tile_index(start);
+        const int goal = tile_index(destination);
+        if (start_tile < 0 || goal < 0) return false;
+
+        route.abstract_path = cluster_graph.find_abstract_path(start_tile, goal);
+        return !route.empty();
+    }
 
+    vec2 Terrain::next_waypoint(HierarchicalRoute& route, const vec2& waypoint) const
+    {
+        if (route.segment_index < route.segment.size()) return tile_corner(route.segment[route.segment_index++]);
+
+        //Segment done, refine the next one, segments are empty when the start or goal tile is an entrance itself
+        while (route.abstract_index + 1 < route.abstract_path.size())
+        {
+            route.segment.clear();
+            route.segment_index = 0;
+            cluster_graph.refine(route.abstract_path[route.abstract_index], route.abstract_path[route.abstract_index + 1], route.segment);
+            route.abstract_index++;
+
+            if (!route.segment.empty()) return tile_corner(route.segment[route.segment_index++]);
         }
+
+        return waypoint;
     }
 
-        //TODO: Function not used, convert BFS to dijkstra and take speed into account next year :)
+    bool Terrain::map_next_hop_table(const fs::path& table_path)
+    {
+        next_hops = nullptr;
+        if (!next_hop_file.open(table_path)) return false;
+
+        //Only use a table that was built for this layout
+        const size_t tile_count = costs.size();
+        NextHopHeader header;
+        if (next_hop_file.get_size() != sizeof(header) + tile_count * tile_count)
+        {
+            next_hop_file.close();
+            return false;
+        }
+
+        std::memcpy(&header, next_hop_file.get_data(), sizeof(header));
+        if (std::memcmp(header.magic, "NEXTHOP1", sizeof(header.magic)) != 0 || header.layout_hash != layout_hash() || header.width != (uint32_t)width || header.height != (uint32_t)height)
+        {
+            next_hop_file.close();
+            return false;
+        }
+
+        next_hops = next_hop_file.get_data() + sizeof(header);
+        return true;
+    }
+
+    uint64_t Terrain::layout_hash() const
+    {
+        //FNV-1a hash of the size and the tiles, a next hop table built for another layout is not used
+        uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash](const uint8_t* data, size_t size) {
+            for (size_t i = 0; i < size; i++) hash = (hash ^ data[i]) * 1099511628211ull;
+        };
+
+        const uint32_t size[2] = { (uint32_t)width, (uint32_t)height };
+        add(reinterpret_cast<const uint8_t*>(size), sizeof(size));
+        add(tiles, (size_t)width * height);
+        return hash;
+    }
+
+    uint8_t Terrain::hop_direction(int tile, int next)
+    {
+        if (next == tile + 1) return HOP_RIGHT;
+        if (next == tile - 1) return HOP_LEFT;
+        return (next > tile) ? HOP_DOWN : HOP_UP;
+    }
+
+    int Terrain::hop_step(int tile, uint8_t hop) const
+    {
+        switch (hop)
+        {
+        case HOP_RIGHT:
+            return tile + 1;
+        case HOP_LEFT:
+            return tile - 1;
+        case HOP_DOWN:
+            return tile + width;
+        default:
+            return tile - width;
+        }
+    }
+
+    PathScratch& Terrain::thread_scratch()
+    {
+        static thread_local PathScratch scratch;
+        return scratch;
+    }
+
+    bool Terrain::can_reach(const FlowField& flow_field, const vec2& position) const
+    {
+        const int tile = tile_index(position);
+        return tile >= 0 && (tile == flow_field.destination || flow_field.next_tile[tile] >= 0);
+    }
+
+    vec2 Terrain::next_waypoint(const FlowField& flow_field, const vec2& waypoint) const
+    {
+        const int tile = tile_index(waypoint);
+        if (tile < 0) return waypoint;
+
+        const int next = flow_field.next_tile[tile];
+        return tile_corner((next >= 0) ? next : tile);
+    }
+
+    int Terrain::tile_index(const vec2& position) const
+    {
+        if (position.x < 0.f || position.y < 0.f) return -1;
+
+        const size_t x = position.x / sprite_size;
+        const size_t y = position.y / sprite_size;
+        if (x >= (size_t)width || y >= (size_t)height) return -1;
+
+        return (int)(y * width + x);
+    }
+
+    vec2 Terrain::tile_corner(int tile) const
+    {
+        return vec2((float)(tile % width) * sprite_size, (float)(tile / width) * sprite_size);
+    }
+
+    float Terrain::tile_cost(TileType tile_type)
+    {
+        const float speed = speed_modifier(tile_type);
+        return (speed > 0.0f) ? 1.0f / speed : numeric_limits<float>::infinity();
+    }
+
+        bool Terrain::is_accessible(const vec2& position) const
+        {
+            const int tile = tile_index(position);
+            return tile >= 0 && (tiles[tile] & tile_passable) != 0;
+        }
+
         float Terrain::get_speed_modifier(const vec2 & position) const
         {
-            const size_t pos_x = position.x / sprite_size;
-            const size_t pos_y = position.y / sprite_size;
+            const int tile = tile_index(position);
+            return (tile >= 0) ? speed_modifier(tile_type(tile)) : 0.0f;
+        }
 
-            switch (tiles.at(pos_y).at(pos_x).tile_type)
+        float Terrain::speed_modifier(TileType tile_type)
+        {
+            switch (tile_type)
             {
             case TileType::GRASS:
                 return 1.0f;
@@ -272,20 +688,4 @@ namespace Tmpl8
                 break;
             }
         }
-    
-
-    bool Terrain::is_accessible(int y, int x)
-    {
-        //Bounds check
-        if ((x >= 0 && x < terrain_width) && (y >= 0 && y < terrain_height))
-        {
-            //Inaccessible terrain check
-            if (tiles.at(y).at(x).tile_type != TileType::MOUNTAINS && tiles.at(y).at(x).tile_type != TileType::WATER)
-            {
-                return true;
-            }
-        }
-
-        return false;
-    }
 }
\ No newline at end of file
@@ -11,43 +11,144 @@ namespace Tmpl8
         WATER
     };
 
-    class TerrainTile
+    //Fastest next step towards one destination tile from every tile of the terrain, shared by all tanks with that destination
+    struct FlowField
     {
-    public:
-        //TerrainTile *up, *down, *left, *right;
-        vector<TerrainTile*> exits;
-        bool visited = false;
-
-        size_t position_x;
-        size_t position_y;
-
-        TileType tile_type;
+        int destination;
 
-    private:
+        //Index of the next tile on the route, -1 on the destination itself and on tiles that can not reach it
+        std::vector<int> next_tile;
     };
 
     class Terrain
     {
     public:
 
+        //Loads assets/terrain.map, or parses assets/terrain.txt if there is no binary map
+        //Builds with BAKED_TERRAIN use the map baked in at build time and read neither file
         Terrain();
 
-        void update();
-        void draw(Surface* target) const;
+        //Binary map format: a header with the size followed by one byte per tile, row by row
+        //The low bits of a tile hold its TileType, tile_passable is set on tiles that can be crossed
+        static constexpr uint8_t tile_type_mask = 0x07;
+        static constexpr uint8_t tile_passable = 0x08;
 
-        //Use Breadth-first search to find shortest route to the destination
-        vector<vec2> get_route(const Tank& tank, const vec2& target);
+        //One-shot conversion of a text map (row count on the first line, then one character per tile) to the binary format
+        static bool convert_text_map(const std::filesystem::path& text_path, const std::filesystem::path& binary_path);
 
+        void update();
+
+        //Copies the background over the whole target, so the target does not have to be cleared first
+        //The background holds the tiles that fit on the screen, it is rendered on first use and again after a tile changed
+        void draw(Surface* target);
+
+        //For drawing only what changed: restore copies one rectangle of the background, which has to be up to date
+        //background_changed is true when the background has to be rendered again for the target, draw then copies all of it
+        bool background_changed(Surface* target) const;
+        void restore(Surface* target, const ScreenRect& rect) const;
+
+        //Fastest route between two tiles, taking the speed on each tile into account
+        //Read from the next hop table when it is loaded, otherwise searched with A*, or with jump point search when all open tiles cost the same
+        //The route holds the tiles from start to goal, it is empty if the goal can not be reached
+        //Safe to call from several threads, get_routes finds the routes of a batch of tanks to their targets on the thread pool
+        vector<int> get_route(int start, int goal) const;
+        vector<vector<int>> get_routes(const vector<Tank>& tanks, ThreadPool& pool) const;
+
+        //Flow field towards the tile of the destination, computed on first use and cached after that
+        //Returns nullptr if the destination is outside the terrain or can not be crossed
+        //Not thread safe, get_flow_fields computes the missing fields of a batch of destinations on the thread pool
+        const FlowField* get_flow_field(const vec2& destination);
+        vector<const FlowField*> get_flow_fields(const vector<vec2>& destinations, ThreadPool& pool);
+
+        //All pairs next hop table, one byte per (destination, source) tile pair with the direction of the next step
+        //Memory maps assets/terrain.nexthop if it was built for the current terrain layout, otherwise builds it on the thread pool and writes it
+        //Once loaded, routes and flow fields are read from the table without searching
+        bool load_next_hop_table(ThreadPool& pool);
+
+        //Compares breadth first search, A* and jump point search on the passability grid, prints expansions and time
+        void benchmark_route_searches(std::ostream& out) const;
+
+        //Hierarchical path finding over cluster entrances for maps that are too big for flow fields and the next hop table
+        //Planning only searches the abstract graph, next_waypoint refines the segment the tank is driving when it starts on it
+        //prepare_hierarchical_routes builds the cluster graph, it has to be called once before planning
+        bool prefers_hierarchical_routes() const { return costs.size() > max_flow_field_tiles; };
+        void prepare_hierarchical_routes();
+        bool plan_route(HierarchicalRoute& route, const vec2& start, const vec2& destination) const;
+        vec2 next_waypoint(HierarchicalRoute& route, const vec2& waypoint) const;
+
+        //Tanks following a flow field drive from tile corner to tile corner, like the points of a route
+        bool can_reach(const FlowField& flow_field, const vec2& position) const;
+        vec2 next_waypoint(const FlowField& flow_field, const vec2& waypoint) const;
+
+        //Path planning grid, the cost of driving onto each tile in rows of get_width tiles
+        const vector<float>& get_costs() const { return costs; };
+        bool has_uniform_cost() const { return uniform_cost; };
+        int get_width() const { return width; };
+        int get_height() const { return height; };
+
+        //Index of the tile at a position (-1 outside the terrain) and the position of its top left corner
+        int tile_index(const vec2& position) const;
+        vec2 tile_corner(int tile) const;
+
+        //Tile queries read the map, they are safe to call from several threads
+        bool is_accessible(const vec2& position) const;
         float get_speed_modifier(const vec2& position) const;
 
 
     private:
 
-        bool is_accessible(int y, int x);
+        struct MapHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t width;
+            uint32_t height;
+        };
+
+        static bool parse_text_map(const std::filesystem::path& text_path, int& width, int& height, vector<uint8_t>& tiles);
+        bool load_binary_map(const std::filesystem::path& binary_path);
+        void init_path_planning();
+
+        TileType tile_type(int tile) const { return (TileType)(tiles[tile] & tile_type_mask); };
+
+        //Draws a rectangle of tile bytes in rows of pitch tiles with its top left tile at (pos_x, pos_y)
+        void draw_tiles(Surface* target, const uint8_t* tile_bytes, int pitch, int columns, int rows, int pos_x, int pos_y) const;
+        int visible_columns() const;
+        int visible_rows() const;
+
+        //Speed factor of a tile type and the cost of crossing it (1 / speed), infinite for tiles that can not be crossed
+        static float speed_modifier(TileType tile_type);
+        static float tile_cost(TileType tile_type);
+
+        std::unique_ptr<FlowField> build_flow_field(int goal) const;
+        std::unique_ptr<FlowField> search_flow_field(int goal) const;
+
+        //Directions in the next hop table
+        enum NextHop : uint8_t
+        {
+            HOP_RIGHT,
+            HOP_LEFT,
+            HOP_DOWN,
+            HOP_UP,
+            HOP_NONE = 0xFF
+        };
+
+        struct NextHopHeader
+        {
+            char magic[8];
+            uint64_t layout_hash;
+            uint32_t width;
+            uint32_t height;
+        };
+
+        uint64_t layout_hash() const;
+        static uint8_t hop_direction(int tile, int next);
+        int hop_step(int tile, uint8_t hop) const;
+        bool map_next_hop_table(const std::filesystem::path& table_path);
+        static PathScratch& thread_scratch();
 
         static constexpr int sprite_size = 16;
-        static constexpr size_t terrain_width = 80;
-        static constexpr size_t terrain_height = 45;
+        static constexpr size_t max_flow_field_tiles = 128 * 128;
 
         std::unique_ptr<Surface> grass_img;
         std::unique_ptr<Surface> forest_img;
@@ -61,6 +162,26 @@ namespace Tmpl8
         std::unique_ptr<Sprite> tile_mountains;
         std::unique_ptr<Sprite> tile_water;
 
-        std::array<std::array<TerrainTile, terrain_width>, terrain_height> tiles;
+        //Tile bytes in rows of width tiles, they point into the mapped map file or into tile_storage for text maps
+        //The pages of a mapped map are only read in when they are used, but the path planning data below is built for the whole map
+        int width = 0;
+        int height = 0;
+        const uint8_t* tiles = nullptr;
+        std::vector<uint8_t> tile_storage;
+        MappedFile map_file;
+
+        //Rendered terrain at screen size, code that changes a tile has to set background_dirty
+        std::unique_ptr<Surface> background;
+        bool background_dirty = true;
+
+        //Path planning data, tile index is y * width + x
+        std::vector<float> costs;
+        bool uniform_cost = false;
+        std::unordered_map<int, std::unique_ptr<FlowField>> flow_fields;
+        ClusterGraph cluster_graph;
+
+        MappedFile next_hop_file;
+        const uint8_t* next_hops = nullptr;
+
     };
 }
\ No newline at end of file
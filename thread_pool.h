@@ -7,16 +7,195 @@ class ThreadPool; //Forward declare
 
 class Worker;
 
+//Unit of work stored in the deques
+class Task
+{
+  public:
+    virtual void run() = 0;
+
+    //Called instead of run when the pool shuts down before the task ran
+    virtual void discard() {}
+
+  protected:
+    ~Task() = default;
+};
+
+//Task created by enqueue, owns the packaged_task and frees itself
+template <class R>
+class PackagedTask final : public Task
+{
+  public:
+    template <class T>
+    explicit PackagedTask(T&& function) : task(std::forward<T>(function)) {}
+
+    void run() override
+    {
+        task();
+        delete this;
+    }
+
+    void discard() override { delete this; }
+
+    std::packaged_task<R()> task;
+};
+
+//Chunk size for parallel_for that adapts to the runtime measured on earlier calls
+//Keep one per loop, chunks are sized so each takes about target_ns while every thread still gets several chunks
+class AdaptiveGrain
+{
+  public:
+    explicit AdaptiveGrain(int alignment = 1, int initial = 64) : alignment(alignment), grain(align_up(initial)) {}
+
+    int size() const { return grain; }
+
+    //Chunks of a call took busy_ns in total for items items
+    void record(int items, int64_t busy_ns, int threads)
+    {
+        if (items <= 0) return;
+
+        const double item_ns = (double)busy_ns / items;
+        ns_per_item = (ns_per_item < 0.0) ? item_ns : ns_per_item * 0.75 + item_ns * 0.25;
+
+        const int by_time = (int)std::min(target_ns / std::max(ns_per_item, 1.0), 1e9);
+        const int by_balance = std::max(items / (threads * chunks_per_thread), 1);
+        grain = align_up(std::min(by_time, by_balance));
+    }
+
+  private:
+    static constexpr double target_ns = 20000.0;
+    static constexpr int chunks_per_thread = 4;
+
+    int align_up(int size) const { return std::max((size + alignment - 1) / alignment, 1) * alignment; }
+
+    int alignment;
+    int grain;
+    double ns_per_item = -1.0;
+};
+
+//Lock free work stealing deque (Chase and Lev, with the memory orderings of Le et al.)
+//Only the owner pushes and takes at the bottom, any thread may steal from the top
+class TaskDeque
+{
+  public:
+    TaskDeque() : array(new Array(64)) {}
+
+    ~TaskDeque()
+    {
+        //Tasks that never ran are dropped, their futures report a broken promise
+        while (Task* task = take())
+            task->discard();
+
+        delete array.load(std::memory_order_relaxed);
+        for (Array* old : old_arrays)
+            delete old;
+    }
+
+    //Owner only, pushes count tasks at once
+    void push(Task* const* tasks, int count)
+    {
+        const int64_t b = bottom.load(std::memory_order_relaxed);
+        const int64_t t = top.load(std::memory_order_acquire);
+        Array* a = array.load(std::memory_order_relaxed);
+
+        while (b + count - t > a->capacity)
+        {
+            a = grow(a, b, t);
+        }
+
+        for (int i = 0; i < count; i++)
+            a->put(b + i, tasks[i]);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + count, std::memory_order_relaxed);
+    }
+
+    //Owner only, returns nullptr when empty
+    Task* take()
+    {
+        const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        Task* task = nullptr;
+        if (t <= b)
+        {
+            task = a->get(b);
+            if (t == b)
+            {
+                //Last task, race the thieves for it
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    task = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    //Any thread, returns nullptr when empty or when another thread won the race
+    Task* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t < b)
+        {
+            Task* task = array.load(std::memory_order_acquire)->get(t);
+            if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return task;
+        }
+        return nullptr;
+    }
+
+  private:
+    struct Array
+    {
+        explicit Array(int64_t size) : capacity(size), mask(size - 1), slots(new std::atomic<Task*>[size]) {}
+        ~Array() { delete[] slots; }
+
+        Task* get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, Task* task) { slots[i & mask].store(task, std::memory_order_relaxed); }
+
+        int64_t capacity;
+        int64_t mask;
+        std::atomic<Task*>* slots;
+    };
+
+    Array* grow(Array* a, int64_t b, int64_t t)
+    {
+        Array* bigger = new Array(a->capacity * 2);
+        for (int64_t i = t; i < b; i++)
+            bigger->put(i, a->get(i));
+
+        //Thieves may still read from the old array, so it is kept until the deque is destroyed
+        old_arrays.push_back(a);
+        array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    //Top and bottom live on their own cache lines, thieves only write top
+    alignas(64) std::atomic<int64_t> top{ 0 };
+    alignas(64) std::atomic<int64_t> bottom{ 0 };
+    alignas(64) std::atomic<Array*> array;
+    std::vector<Array*> old_arrays;
+};
+
 class Worker
 {
   public:
     //Instantiate the worker class by passing and storing the threadpool as a reference
-    Worker(ThreadPool& s) : pool(s) {}
+    Worker(ThreadPool& s, size_t i) : pool(s), index(i) {}
 
     inline void operator()();
 
   private:
     ThreadPool& pool;
+    size_t index;
 };
 
 class ThreadPool
@@ -24,76 +203,289 @@ class ThreadPool
   public:
     ThreadPool(size_t numThreads) : stop(false)
     {
+        //Deque 0 takes tasks from threads outside of the pool, every worker owns one of the others
+        deques.reserve(numThreads + 1);
+        for (size_t i = 0; i < numThreads + 1; ++i)
+            deques.push_back(std::make_unique<TaskDeque>());
+
         for (size_t i = 0; i < numThreads; ++i)
-            workers.push_back(std::thread(Worker(*this)));
+            workers.push_back(std::thread(Worker(*this, i + 1)));
     }
 
     ~ThreadPool()
     {
         stop = true; // stop all threads
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+        }
         condition.notify_all();
 
         for (auto& thread : workers)
             thread.join();
     }
 
+    //Number of threads that work on a parallel_for, the workers and the calling thread
+    int thread_count() const { return (int)workers.size() + 1; }
+
+    //Index of the worker running on this thread starting at 1, 0 for threads outside of any pool
+    static int current_thread() { return current_pool ? (int)current_index : 0; }
+
+    //Runs queued tasks on the calling thread until done() returns true
+    template <class P>
+    void help_until(const P& done)
+    {
+        while (!done())
+        {
+            if (!run_one())
+                std::this_thread::yield();
+        }
+    }
+
     template <class T>
     auto enqueue(T task) -> std::future<decltype(task())>
     {
         //Wrap the function in a packaged_task so we can return a future object
-        auto wrapper = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        auto* wrapper = new PackagedTask<decltype(task())>(std::move(task));
+        auto future = wrapper->task.get_future();
 
-        //Scope to restrict critical section
+        Task* queued = wrapper;
+        submit(&queued, 1);
+
+        return future;
+    }
+
+    //Pushes tasks with one lock (or none from a worker) and wakes parked workers
+    //The tasks are not copied, the caller keeps them alive until they ran or were discarded
+    void submit(Task* const* tasks, int count)
+    {
+        if (current_pool == this)
         {
-            //lock our queue and add the given task to it
-            std::unique_lock<std::mutex> lock(queue_mutex);
+            //Tasks spawned by a worker go to the bottom of its own deque
+            deques[current_index]->push(tasks, count);
+        }
+        else
+        {
+            //Outside threads share deque 0, pushes are serialized but workers steal from it without locking
+            std::lock_guard<std::mutex> lock(submit_mutex);
+            deques[0]->push(tasks, count);
+        }
 
-            tasks.push_back([=] {
-                (*wrapper)();
-            });
+        //Only wake workers when some are parked, spinning workers will find the tasks by themselves
+        pending.fetch_add(count);
+        if (sleeping.load() > 0)
+        {
+            {
+                std::unique_lock<std::mutex> lock(sleep_mutex);
+            }
+            if (count == 1)
+                condition.notify_one();
+            else
+                condition.notify_all();
         }
+    }
 
-        //Wake up a thread to start this task
-        condition.notify_one();
+    //Calls function(chunk_begin, chunk_end) for consecutive chunks of grain items covering [begin, end)
+    //The calling thread works along and returns when every chunk is done
+    template <class F>
+    void parallel_for(int begin, int end, int grain, const F& function)
+    {
+        run_range(begin, end, grain, function);
+    }
 
-        return wrapper->get_future();
+    //Same as above, the chunk size is taken from grain and updated with the measured chunk runtimes
+    template <class F>
+    void parallel_for(int begin, int end, AdaptiveGrain& grain, const F& function)
+    {
+        const int64_t busy_ns = run_range(begin, end, grain.size(), function);
+        grain.record(end - begin, busy_ns, thread_count());
+    }
+
+    //Calls function(chunk_begin, chunk_end) for every chunk like parallel_for and combines the returned values with reduce
+    //Values are combined in chunk order, so the result only depends on the grain and not on the threads
+    template <class T, class F, class R>
+    T parallel_reduce(int begin, int end, int grain, T identity, const F& function, const R& reduce)
+    {
+        grain = std::max(grain, 1);
+        const int chunk_count = (end - begin + grain - 1) / grain;
+        std::vector<T> results(std::max(chunk_count, 0), identity);
+
+        run_range(begin, end, grain, [&](int chunk_begin, int chunk_end) { results[(chunk_begin - begin) / grain] = function(chunk_begin, chunk_end); });
+
+        T result = identity;
+        for (const T& value : results)
+            result = reduce(result, value);
+        return result;
     }
 
   private:
     friend class Worker; //Gives access to the private variables of this class
 
+    //Number of failed steal rounds before a worker parks
+    static constexpr int spin_rounds = 256;
+
+    //Shared state of one parallel_for, lives on the stack of the calling thread
+    //The same job is pushed once per helping worker, every copy takes chunks until none are left
+    class RangeJob final : public Task
+    {
+      public:
+        void run() override
+        {
+            work();
+            helpers.fetch_sub(1, std::memory_order_release); //Last access, the caller may return after this
+        }
+
+        void discard() override { helpers.fetch_sub(1, std::memory_order_release); }
+
+        void work()
+        {
+            int64_t ns = 0;
+            for (int chunk = next_chunk.fetch_add(1); chunk < chunk_count; chunk = next_chunk.fetch_add(1))
+            {
+                const int chunk_begin = begin + chunk * grain;
+                const auto start = std::chrono::steady_clock::now();
+                call(function, chunk_begin, std::min(chunk_begin + grain, end));
+                ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+            busy_ns.fetch_add(ns, std::memory_order_relaxed);
+        }
+
+        int begin = 0;
+        int end = 0;
+        int grain = 1;
+        int chunk_count = 0;
+        void (*call)(const void* function, int begin, int end) = nullptr;
+        const void* function = nullptr;
+
+        std::atomic<int> next_chunk{ 0 };
+        std::atomic<int> helpers{ 0 };
+        std::atomic<int64_t> busy_ns{ 0 };
+    };
+
+    //Runs a parallel_for and returns the summed runtime of its chunks
+    template <class F>
+    int64_t run_range(int begin, int end, int grain, const F& function)
+    {
+        if (end <= begin) return 0;
+
+        RangeJob job;
+        job.begin = begin;
+        job.end = end;
+        job.grain = std::max(grain, 1);
+        job.chunk_count = (end - begin + job.grain - 1) / job.grain;
+        job.call = [](const void* f, int chunk_begin, int chunk_end) { (*static_cast<const F*>(f))(chunk_begin, chunk_end); };
+        job.function = &function;
+
+        //One task per helping worker instead of one per chunk, the calling thread takes the first chunk itself
+        const int helpers = std::min((int)workers.size(), job.chunk_count - 1);
+        if (helpers > 0)
+        {
+            job.helpers.store(helpers, std::memory_order_relaxed);
+
+            Task* copies[64];
+            for (int submitted = 0; submitted < helpers; submitted += 64)
+            {
+                const int count = std::min(helpers - submitted, 64);
+                std::fill(copies, copies + count, &job);
+                submit(copies, count);
+            }
+        }
+
+        job.work();
+
+        //Help with other work until every helper left the job
+        help_until([&job]() { return job.helpers.load(std::memory_order_acquire) == 0; });
+
+        return job.busy_ns.load(std::memory_order_relaxed);
+    }
+
+    //Runs one queued task on the current thread, returns false if none was found
+    bool run_one()
+    {
+        const size_t self = (current_pool == this) ? current_index : 0;
+
+        Task* task = (self != 0) ? deques[self]->take() : nullptr;
+        if (!task) task = steal(self, steal_random);
+        if (!task) return false;
+
+        pending.fetch_sub(1);
+        task->run();
+        return true;
+    }
+
+    //Tries to steal a task starting at a random victim
+    Task* steal(size_t thief, uint32_t& random)
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        const size_t count = deques.size();
+        const size_t first = random % count;
+        for (size_t i = 0; i < count; i++)
+        {
+            const size_t victim = (first + i) % count;
+            if (victim == thief && thief != 0) continue;
+
+            if (Task* task = deques[victim]->steal())
+                return task;
+        }
+        return nullptr;
+    }
+
     std::vector<std::thread> workers;
-    std::deque<std::function<void()>> tasks;
+    std::vector<std::unique_ptr<TaskDeque>> deques;
 
-    std::condition_variable condition; //Wakes up a thread when work is available
+    std::condition_variable condition; //Wakes up a parked thread when work is available
 
-    std::mutex queue_mutex; //Lock for our queue
-    bool stop = false;
+    std::mutex submit_mutex; //Serializes pushes to deque 0
+    std::mutex sleep_mutex;  //Only used for parking
+    std::atomic<int> pending{ 0 };  //Tasks pushed but not yet taken
+    std::atomic<int> sleeping{ 0 }; //Workers parked on the condition variable
+    std::atomic<bool> stop;
+
+    //Identifies the worker running on this thread, so nested enqueues go to its own deque
+    static inline thread_local ThreadPool* current_pool = nullptr;
+    static inline thread_local size_t current_index = 0;
+    static inline thread_local uint32_t steal_random = 2463534242u;
 };
 
 inline void Worker::operator()()
 {
-    std::function<void()> task;
-    while (true)
-    {
-        //Scope to restrict critical section
-        //This is important because we don't want to hold the lock while executing the task,
-        //because that would make it so only one task can be run simultaneously (aka sequantial)
-        {
-            std::unique_lock<std::mutex> locker(pool.queue_mutex);
+    ThreadPool::current_pool = &pool;
+    ThreadPool::current_index = index;
+    ThreadPool::steal_random = (uint32_t)index * 2654435761u + 1;
 
-            //Wait until some work is ready or we are stopping the threadpool
-            //Because of spurious wakeups we need to check if there is actually a task available or we are stopping
-            pool.condition.wait(locker, [=] { return pool.stop || !pool.tasks.empty(); });
+    int spins = 0;
 
-            if (pool.stop) break;
+    while (!pool.stop)
+    {
+        //Own work first (newest first, it is still in cache), then steal the oldest work of others
+        if (pool.run_one())
+        {
+            spins = 0;
+            continue;
+        }
 
-            task = pool.tasks.front();
-            pool.tasks.pop_front();
+        //Spin for a short while, new work usually arrives within the same frame
+        //Yield after the first rounds so an oversubscribed core still runs the thread that submits the work
+        if (++spins < ThreadPool::spin_rounds)
+        {
+            if (spins < 64)
+                _mm_pause();
+            else
+                std::this_thread::yield();
+            continue;
         }
 
-        task();
+        //Park until a task is pushed, sleeping is published before pending is checked so no wake up is lost
+        pool.sleeping.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> locker(pool.sleep_mutex);
+            pool.condition.wait(locker, [this] { return pool.stop || pool.pending.load() > 0; });
+        }
+        pool.sleeping.fetch_sub(1);
+        spins = 0;
     }
 }
 
-} // namespace Tmpl8
\ No newline at end of file
+} // namespace Tmpl8